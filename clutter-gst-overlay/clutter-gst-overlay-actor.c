@@ -28,41 +28,220 @@
  */
 
 #include "clutter-gst-overlay-actor.h"
+#include "clutter-gst-overlay-private.h"
+#include "clutter-gst-overlay-timeshift.h"
+#include "clutter-gst-overlay-subtitles.h"
+#include "clutter-gst-overlay-audio-mixer.h"
+#include "clutter-gst-overlay-trace.h"
 #include <gst/interfaces/xoverlay.h>
 #include <gst/video/video.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/base/gstbasesink.h>
+#include <gst/base/gstbasesrc.h>
+#include <gst/base/gstbasetransform.h>
 #include <X11/Xlib.h>
+#include <X11/extensions/shape.h>
+#include <string.h>
 
 #define CLUTTER_GST_OVERLAY_ACTOR_GET_PRIVATE(obj) \
         (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
         CLUTTER_TYPE_GST_OVERLAY_ACTOR, ClutterGstOverlayActorPrivate))
 
+/* One child of the stage window holding the video of every
+ * SHARED_WINDOW actor on that stage, shaped to their rectangles.
+ */
+typedef struct {
+  Display      *display;
+  Window        window;
+  ClutterActor *stage;
+  gint          ref_count;
+  GList        *actors;
+  gint          width;
+  gint          height;
+  gboolean      mapped;
+} SharedWindow;
+
 struct _ClutterGstOverlayActorPrivate
 {
   GstElement *pipeline;
   GstElement *video_sink;
+  GstElement *window_sink;
+  GstElement *texture_sink;
+
+  /* Scale and convert bins around the sinks; video_sink is one of
+   * them. window_scales is FALSE when the window sink scales itself.
+   */
+  GstElement  *window_output;
+  GstElement  *texture_output;
+  gboolean     window_scales;
+  gint         scale_width;
+  gint64       convert_started;
+  gboolean     conversion_path;
+  GstClockTime conversion_time;
 
   Display    *display;
   Window      window;
 
+  ClutterGstOverlayRenderMode render_mode;
+
+  /* Texture mode: the streaming thread parks the newest frame in
+   * pending_frame, paint uploads it into the back texture and flips.
+   */
+  GMutex     *frame_lock;
+  GstBuffer  *pending_frame;
+  gboolean    redraw_queued;
+  CoglHandle  frame_textures[2];
+  gint        front_texture;
+  CoglHandle  frame_material;
+  guint64     frames_uploaded;
+  guint64     frames_skipped;
+
   gchar      *font_name;
   gdouble     buffer_fill;
 
+  /* Last sink buffer and its upload, reused until the frame changes */
+  GstBuffer  *snapshot_buffer;
+  CoglHandle  snapshot_texture;
+
+  /* Frame rate cap, applied on raw frames ahead of playsink */
+  gdouble      max_framerate;
+  gboolean     auto_framerate;
+  GstClockTime frame_interval;
+  GstClockTime last_frame_ts;
+  GstPad      *frame_cap_pad;
+  gulong       frame_caps_handler;
+  gulong       frame_cap_probe;
+  guint64      frames_dropped;
+  guint64      frame_bytes_dropped;
+
+  /* Decoders created inside playbin2, guarded by actors_lock */
+  gint         decoder_threads;
+  gfloat       screen_area;
+  GList       *decoders;
+
+  /* Queues sharing the memory budget, guarded by actors_lock */
+  guint64      memory_budget;
+  GList       *queues;
+
+  /* Size-aware selection of the video stream and HLS variant */
+  gboolean     auto_video;
+  guint        connection_speed;
+  gdouble      pixel_savings;
+  gdouble      bitrate_savings;
+
+  ClutterGstOverlayLatencyProfile latency_profile;
+  GstPlayFlags live_saved_flags;
+  GstClockTime latency;
+  GstClockTime measured_latency;
+
+  /* Timeshift: a second pipeline writes the source bytes into the
+   * ring, playbin2 reads them back through appsrc at read_offset.
+   */
+  guint64      timeshift_size;
+  ClutterGstOverlayTimeshift *timeshift;
+  GstElement  *timeshift_ingest;
+  GstElement  *timeshift_src;
+  gchar       *timeshift_uri;
+  GMutex      *timeshift_lock;
+  guint64      timeshift_read_offset;
+  gboolean     timeshift_starved;
+  gboolean     timeshift_resyncing;
+  guint64      timeshift_seek_offset;
+  GstClockTime timeshift_epoch;
+  guint        timeshift_watch;
+
+  /* Error recovery */
+  guint        max_retries;
+  guint        retry;
+  guint        retry_source;
+  gint         recovery_phase;
+  gboolean     recover_playing;
+  gint64       recover_position;
+  gint         recover_audio;
+  gint         recover_text;
+  gint64       recovery_started;
+  guint        recovery_count;
+  guint        retry_count;
+  GstClockTime last_recovery_time;
+
+  /* Media info cache, reset with the URI */
+  GstClockTime cached_duration;
+  gint         cached_can_seek;
+  GstTagList  *tags;
+
+  /* Negotiated video format, from the selector src pad caps;
+   * guarded by frame_lock. video_width is 0 until negotiated.
+   */
+  gint         video_width;
+  gint         video_height;
+  gint         video_par_n;
+  gint         video_par_d;
+  gint         video_fps_n;
+  gint         video_fps_d;
+
+  /* Stream switching. The text overlay is silenced instead of
+   * clearing GST_PLAY_FLAG_TEXT; the switch probe sits on a selector
+   * src pad until the first buffer after a switch. Guarded by
+   * frame_lock.
+   */
+  GstElement  *text_overlay;
+  gboolean     subtitles_visible;
+  GstPad      *switch_pad;
+  gulong       switch_probe;
+  gint64       switch_started;
+  GstClockTime last_switch_latency;
+
+  /* Indexed external subtitles. subtitle_bin (textoverlay in front of
+   * video_sink) is made in init and stays playbin2's video-sink. The
+   * cue span and segment are guarded by frame_lock.
+   */
+  ClutterGstOverlaySubtitles *subtitles;
+  GstElement  *subtitle_bin;
+  GstElement  *subtitle_overlay;
+  GstSegment   subtitle_segment;
+  GstClockTime cue_start;
+  GstClockTime cue_end;
+
+  /* Shared audio: gain and mute live in the mixer channel */
+  ClutterGstOverlayAudioChannel *audio_channel;
+
+  /* Window shape, in window coordinates; the last one sent to X */
+  gboolean     has_shape;
+  gboolean     shaped;
+  XRectangle   shape_rect;
+  gboolean     fully_clipped;
+  guint        clipped_pixels;
+
+  /* SHARED_WINDOW mode: the stage's window, the whole frame's
+   * rectangle inside it and the visible part the shape lets through,
+   * empty while hidden or clipped.
+   */
+  SharedWindow *shared_window;
+  XRectangle   shared_render;
+  XRectangle   shared_rect;
+
+  /* Fullscreen: the window covers the stage and only the stage's
+   * allocation is tracked.
+   */
+  gboolean     fullscreen;
+
+  /* Window geometry waiting for the next flush of X requests */
+  gboolean     x_dirty;
+  Window       x_pending_parent;
+  gfloat       x_x, x_y, x_width, x_height;
+  guint        x_errors;
+
+  /* Start of traced spans ended by later events, 0 when none is open.
+   * trace_first_frame is guarded by frame_lock.
+   */
+  gint64       trace_preroll;
+  gint64       trace_first_frame;
+  gint64       trace_seek;
+
   ClutterGstOverlayStates states;
 };
 
-typedef enum {
-  GST_PLAY_FLAG_VIDEO         = (1 << 0),
-  GST_PLAY_FLAG_AUDIO         = (1 << 1),
-  GST_PLAY_FLAG_TEXT          = (1 << 2),
-  GST_PLAY_FLAG_VIS           = (1 << 3),
-  GST_PLAY_FLAG_SOFT_VOLUME   = (1 << 4),
-  GST_PLAY_FLAG_NATIVE_AUDIO  = (1 << 5),
-  GST_PLAY_FLAG_NATIVE_VIDEO  = (1 << 6),
-  GST_PLAY_FLAG_DOWNLOAD      = (1 << 7),
-  GST_PLAY_FLAG_BUFFERING     = (1 << 8),
-  GST_PLAY_FLAG_DEINTERLACE   = (1 << 9)
-} GstPlayFlags;
-
 enum {
   PROP_0,
 
@@ -83,10 +262,74 @@ enum {
   PROP_CURRENT_TEXT,
   PROP_CURRENT_AUDIO,
   PROP_CURRENT_VIDEO,
-  PROP_MUTE
+  PROP_MUTE,
+
+  PROP_RENDER_MODE,
+  PROP_FRAMES_UPLOADED,
+  PROP_FRAMES_SKIPPED,
+
+  PROP_MAX_FRAMERATE,
+  PROP_AUTO_FRAMERATE,
+  PROP_FRAMES_DROPPED,
+  PROP_FRAME_BYTES_DROPPED,
+
+  PROP_DECODER_THREADS,
+
+  PROP_MEMORY_BUDGET,
+  PROP_MEMORY_USED,
+
+  PROP_AUTO_VIDEO,
+  PROP_PIXEL_SAVINGS,
+  PROP_BITRATE_SAVINGS,
+
+  PROP_LATENCY_PROFILE,
+  PROP_LATENCY,
+  PROP_MEASURED_LATENCY,
+
+  PROP_TIMESHIFT_SIZE,
+
+  PROP_MAX_RETRIES,
+  PROP_RECOVERY_COUNT,
+  PROP_RETRY_COUNT,
+  PROP_LAST_RECOVERY_TIME,
+
+  PROP_LAST_SWITCH_LATENCY,
+
+  PROP_SHARED_AUDIO,
+
+  PROP_CLIPPED_PIXELS,
+
+  PROP_X_ERRORS,
+
+  PROP_FULLSCREEN,
+
+  PROP_CONVERSION_PATH,
+  PROP_CONVERSION_TIME
+};
+
+enum {
+  VIDEO_SIZE_CHANGED,
+
+  LAST_SIGNAL
 };
 
+static guint signals[LAST_SIGNAL] = { 0, };
+
 static void clutter_media_interface_init (ClutterMediaIface *iface);
+static void stop_timeshift (ClutterGstOverlayActor *self);
+static void set_timeshift_progress (ClutterGstOverlayActor *self,
+                                    gdouble                 progress);
+static void cancel_recovery (ClutterGstOverlayActor *self);
+static void remove_switch_probe_locked (ClutterGstOverlayActorPrivate *priv);
+static void allocate_shared (ClutterGstOverlayActor *self);
+static void attach_shared_window (ClutterGstOverlayActor *self,
+                                  ClutterActor           *stage);
+static void select_video_stream (ClutterGstOverlayActor *self,
+                                 gfloat width, gfloat height);
+static void update_scale_caps (ClutterGstOverlayActor *self, gfloat width);
+static void set_shared_rect (ClutterGstOverlayActor *self,
+                             const XRectangle *render,
+                             gint x, gint y, gint w, gint h);
 
 G_DEFINE_TYPE_WITH_CODE (ClutterGstOverlayActor,
                          clutter_gst_overlay_actor,
@@ -94,288 +337,3254 @@ G_DEFINE_TYPE_WITH_CODE (ClutterGstOverlayActor,
                          G_IMPLEMENT_INTERFACE (CLUTTER_TYPE_MEDIA,
                                                 clutter_media_interface_init));
 
-static void
-clutter_gst_overlay_actor_dispose (GObject *gobject)
+/* Process-wide decoder threading settings and the live actors
+ * the decode budget is shared between.
+ */
+static GStaticMutex actors_lock = G_STATIC_MUTEX_INIT;
+static GList *actors = NULL;
+static gint default_decoder_threads = 0;
+static gint decode_budget = 0;
+static guint64 total_memory_budget = 0;
+
+/* Startup cost: prewarm_time is NONE until the prewarm thread is
+ * done, first_actor_latency until the first actor is built.
+ */
+static GStaticMutex prewarm_lock = G_STATIC_MUTEX_INIT;
+static GThread *prewarm_thread = NULL;
+static GstClockTime prewarm_time = GST_CLOCK_TIME_NONE;
+static GstClockTime first_actor_latency = GST_CLOCK_TIME_NONE;
+
+static const gchar *
+get_threads_property (GstElement *element)
 {
-  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (gobject)->priv;
+  GObjectClass *klass = G_OBJECT_GET_CLASS (element);
 
-  if (priv->pipeline)
-    {
-      gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+  if (g_object_class_find_property (klass, "max-threads"))
+    return "max-threads";
 
-      gst_object_unref (GST_OBJECT (priv->pipeline));
+  if (g_object_class_find_property (klass, "threads"))
+    return "threads";
 
-      priv->pipeline = NULL;
-    }
+  return NULL;
+}
 
-  G_OBJECT_CLASS (clutter_gst_overlay_actor_parent_class)->dispose (gobject);
+static gboolean
+is_decoder (GstElement *element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  return factory &&
+         strstr (gst_element_factory_get_klass (factory), "Decoder") != NULL;
 }
 
-static void
-clutter_gst_overlay_actor_finalize (GObject *gobject)
+/* Call with actors_lock held. 0 leaves the choice to the decoder. */
+static gint
+get_decoder_threads_locked (ClutterGstOverlayActor *self)
 {
-  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (gobject)->priv;
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  gint threads = priv->decoder_threads > 0 ? priv->decoder_threads :
+                                             default_decoder_threads;
 
-  g_free (priv->font_name);
+  if (decode_budget > 0)
+    {
+      gfloat total_area = 0;
+      gint share;
+      GList *l;
 
-  XDestroyWindow (priv->display, priv->window);
+      for (l = actors; l; l = l->next)
+        total_area += CLUTTER_GST_OVERLAY_ACTOR (l->data)->priv->screen_area;
 
-  G_OBJECT_CLASS (clutter_gst_overlay_actor_parent_class)->finalize (gobject);
+      if (total_area > 0)
+        share = decode_budget * priv->screen_area / total_area;
+      else
+        share = decode_budget / MAX (g_list_length (actors), 1);
+
+      share = MAX (share, 1);
+      threads = threads > 0 ? MIN (threads, share) : share;
+    }
+
+  return threads;
 }
 
 static void
-clutter_gst_overlay_actor_show (ClutterActor *self,
-                                gpointer      user_data)
+decoder_finalized (gpointer  data,
+                   GObject  *decoder)
 {
-  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  ClutterGstOverlayActorPrivate *priv = data;
 
-  XMapWindow (priv->display, priv->window);
+  g_static_mutex_lock (&actors_lock);
+  priv->decoders = g_list_remove (priv->decoders, decoder);
+  g_static_mutex_unlock (&actors_lock);
 }
 
+/* Call with actors_lock held. Decoders such as ffdec read the value
+ * when they open, so a change reaches decoders created afterwards.
+ */
 static void
-clutter_gst_overlay_actor_hide (ClutterActor *self,
-                                gpointer      user_data)
+apply_decoder_threads_locked (ClutterGstOverlayActor *self)
 {
-  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  gint threads = get_decoder_threads_locked (self);
+  GList *l;
 
-  XUnmapWindow (priv->display, priv->window);
+  for (l = self->priv->decoders; l; l = l->next)
+    g_object_set (G_OBJECT (l->data),
+                  get_threads_property (GST_ELEMENT (l->data)), threads,
+                  NULL);
 }
 
 static void
-clutter_gst_overlay_actor_allocate (ClutterActor *self,
-                                    ClutterActorBox *box,
-                                    ClutterAllocationFlags flags,
-                                    gpointer user_data)
+rebalance_decoder_threads (void)
 {
-  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
-  gfloat x, y, w, h;
-
-  clutter_actor_get_transformed_position (self, &x, &y);
-
-  clutter_actor_get_transformed_size (self, &w, &h);
-
-  /* In XResizeWindow
-   * if either width or height is zero,
-   * a BadValue error results.
-   */
-  if (w <= 0)
-    w = 1;
+  GList *l;
 
-  if (h <= 0)
-    h = 1;
+  g_static_mutex_lock (&actors_lock);
 
-  XMoveResizeWindow (priv->display, priv->window,
-                     x, y, w, h);
+  for (l = actors; l; l = l->next)
+    apply_decoder_threads_locked (CLUTTER_GST_OVERLAY_ACTOR (l->data));
 
-  gst_x_overlay_expose (GST_X_OVERLAY (priv->video_sink));
+  g_static_mutex_unlock (&actors_lock);
 }
 
 static void
-clutter_gst_overlay_actor_parent_set (ClutterActor *self,
-                                      ClutterActor *old_parent,
-                                      gpointer      user_data)
+configure_decoder (ClutterGstOverlayActor *self,
+                   GstElement             *element)
 {
-  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
-  ClutterStage *stage_new_parent = CLUTTER_STAGE (clutter_actor_get_stage (self));
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  const gchar *threads_property;
 
-  if (!CLUTTER_IS_STAGE (stage_new_parent))
+  if (!is_decoder (element))
     return;
 
-  ClutterActor *parent = clutter_actor_get_parent (self);
-  Window window_new_parent = clutter_x11_get_stage_window (stage_new_parent);
+  threads_property = get_threads_property (element);
 
-  /* We should track all parents for getting 'allocate' signal
-   * for correct allocating X window in stage coordinates
-   * when any parent moved and 'parent_set' signal
-   * for get 'allocate' signal from new parent of any parent
-   */
+  if (!threads_property)
+    return;
 
-  g_signal_handlers_disconnect_by_func (self,
-                                        clutter_gst_overlay_actor_allocate,
-                                        self);
-  g_signal_handlers_disconnect_by_func (self,
-                                        clutter_gst_overlay_actor_parent_set,
-                                        self);
+  g_static_mutex_lock (&actors_lock);
 
-  while (parent)
-    {
-      g_signal_connect_swapped (parent, "parent-set",
-                                G_CALLBACK (clutter_gst_overlay_actor_parent_set),
-                                self);
+  priv->decoders = g_list_prepend (priv->decoders, element);
+  g_object_weak_ref (G_OBJECT (element), decoder_finalized, priv);
 
-      g_signal_connect_swapped (parent, "allocation-changed",
-                                G_CALLBACK (clutter_gst_overlay_actor_allocate),
-                                self);
+  g_object_set (G_OBJECT (element),
+                threads_property, get_decoder_threads_locked (self),
+                NULL);
 
-      parent = clutter_actor_get_parent (parent);
-    }
+  g_static_mutex_unlock (&actors_lock);
+}
 
-  XReparentWindow (priv->display, priv->window,
-                   window_new_parent, 0, 0);
+/* Memory budget. It is split evenly between the queues of the actor's
+ * pipeline (queue, queue2 and multiqueue) as max-size-bytes. Each
+ * queue keeps the limit its parent bin asked for in qdata, so lifting
+ * the budget restores it. decodebin2 resets its multiqueue limits
+ * after preroll, so the cap is re-applied whenever the limit changes.
+ * multiqueue may still grow past the limit to avoid a deadlock when
+ * one of its queues runs empty.
+ */
 
-  clutter_gst_overlay_actor_allocate (self, NULL, 0, NULL);
+static GQuark
+queue_cap_quark (void)
+{
+  return g_quark_from_static_string ("clutter-gst-overlay-queue-cap");
 }
 
-static gint
-get_pipeline_int_prop (ClutterGstOverlayActor *self,
-                       const gchar            *prop)
+static GQuark
+queue_wanted_quark (void)
 {
-  gint value = -1;
+  return g_quark_from_static_string ("clutter-gst-overlay-queue-wanted");
+}
 
-  g_object_get (G_OBJECT (self->priv->pipeline), prop, &value, NULL);
+/* Call with actors_lock held. 0 means no budget. */
+static guint64
+get_memory_budget_locked (ClutterGstOverlayActor *self)
+{
+  guint64 budget = self->priv->memory_budget;
 
-  return value;
+  if (total_memory_budget > 0)
+    {
+      guint64 share = total_memory_budget / MAX (g_list_length (actors), 1);
+
+      budget = budget > 0 ? MIN (budget, share) : share;
+    }
+
+  return budget;
 }
 
 static void
-set_pipeline_int_prop (ClutterGstOverlayActor *self,
-                       const gchar            *prop,
-                       gint                    value)
+queue_limit_notify (GObject    *queue,
+                    GParamSpec *pspec,
+                    gpointer    data)
 {
-  g_object_set (G_OBJECT (self->priv->pipeline), prop, value, NULL);
-}
+  guint cap = GPOINTER_TO_UINT (g_object_get_qdata (queue, queue_cap_quark ()));
+  guint bytes;
 
-static gint
-get_n_text (ClutterGstOverlayActor *self)
-{
-  return get_pipeline_int_prop (self, "n-text");
+  g_object_get (queue, "max-size-bytes", &bytes, NULL);
+
+  /* Our own write */
+  if (cap > 0 && bytes == cap)
+    return;
+
+  g_object_set_qdata (queue, queue_wanted_quark (), GUINT_TO_POINTER (bytes));
+
+  if (cap > 0 && (bytes == 0 || bytes > cap))
+    g_object_set (queue, "max-size-bytes", cap, NULL);
 }
 
-static gint
-get_n_audio (ClutterGstOverlayActor *self)
+static void
+queue_finalized (gpointer  data,
+                 GObject  *queue)
 {
-  return get_pipeline_int_prop (self, "n-audio");
+  ClutterGstOverlayActorPrivate *priv = data;
+
+  g_static_mutex_lock (&actors_lock);
+  priv->queues = g_list_remove (priv->queues, queue);
+  g_static_mutex_unlock (&actors_lock);
 }
 
-static gint
-get_n_video (ClutterGstOverlayActor *self)
+/* Call with actors_lock held */
+static void
+apply_memory_budget_locked (ClutterGstOverlayActor *self)
 {
-  return get_pipeline_int_prop (self, "n-video");
+  guint64 budget = get_memory_budget_locked (self);
+  guint n = g_list_length (self->priv->queues);
+  guint cap = 0;
+  GList *l;
+
+  /* The caps add up to at most the budget; 0 would mean no limit */
+  if (budget > 0 && n > 0)
+    cap = MAX (MIN (budget / n, G_MAXUINT), 1);
+
+  for (l = self->priv->queues; l; l = l->next)
+    {
+      GObject *queue = G_OBJECT (l->data);
+      guint wanted = GPOINTER_TO_UINT (g_object_get_qdata (queue,
+                                                           queue_wanted_quark ()));
+
+      g_object_set_qdata (queue, queue_cap_quark (), GUINT_TO_POINTER (cap));
+      g_object_set (queue,
+                    "max-size-bytes",
+                    cap == 0 ? wanted : wanted > 0 ? MIN (wanted, cap) : cap,
+                    NULL);
+    }
 }
 
-static gint
-get_current_text (ClutterGstOverlayActor *self)
+static void
+rebalance_memory_budget (void)
 {
-  return get_pipeline_int_prop (self, "current-text");
+  GList *l;
+
+  g_static_mutex_lock (&actors_lock);
+
+  for (l = actors; l; l = l->next)
+    apply_memory_budget_locked (CLUTTER_GST_OVERLAY_ACTOR (l->data));
+
+  g_static_mutex_unlock (&actors_lock);
 }
 
-static gint
-get_current_audio (ClutterGstOverlayActor *self)
+static void
+configure_queue (ClutterGstOverlayActor *self,
+                 GstElement             *element)
 {
-  return get_pipeline_int_prop (self, "current-audio");
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  guint bytes;
+
+  if (!g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+                                     "max-size-bytes"))
+    return;
+
+  g_object_get (G_OBJECT (element), "max-size-bytes", &bytes, NULL);
+  g_object_set_qdata (G_OBJECT (element), queue_wanted_quark (),
+                      GUINT_TO_POINTER (bytes));
+
+  g_signal_connect (element, "notify::max-size-bytes",
+                    G_CALLBACK (queue_limit_notify), NULL);
+
+  g_static_mutex_lock (&actors_lock);
+
+  priv->queues = g_list_prepend (priv->queues, element);
+  g_object_weak_ref (G_OBJECT (element), queue_finalized, priv);
+
+  apply_memory_budget_locked (self);
+
+  g_static_mutex_unlock (&actors_lock);
 }
 
-static gint
-get_current_video (ClutterGstOverlayActor *self)
+/* Bytes held in the actor's queues; multiqueue does not report it */
+static guint64
+get_memory_used (ClutterGstOverlayActor *self)
 {
-  return get_pipeline_int_prop (self, "current-video");
+  guint64 used = 0;
+  GList *l;
+
+  g_static_mutex_lock (&actors_lock);
+
+  for (l = self->priv->queues; l; l = l->next)
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (l->data),
+                                      "current-level-bytes"))
+      {
+        guint bytes = 0;
+
+        g_object_get (G_OBJECT (l->data), "current-level-bytes", &bytes, NULL);
+        used += bytes;
+      }
+
+  g_static_mutex_unlock (&actors_lock);
+
+  return used;
 }
 
-static void
-set_current_text (ClutterGstOverlayActor *self,
-                  gint                    stream)
+/* Live profile tuning. Queues hold a few frames instead of seconds,
+ * jitterbuffers wait briefly and sinks drop late frames rather than
+ * stall the pipeline.
+ */
+#define LIVE_QUEUE_TIME          (200 * GST_MSECOND)
+#define LIVE_JITTER_LATENCY_MS   50
+#define LIVE_MAX_LATENESS        (20 * GST_MSECOND)
+
+static gboolean
+is_jitterbuffer (GstElement *element)
 {
-  set_pipeline_int_prop (self, "current-text", stream);
+  static const gchar *names[] = {
+    "rtspsrc", "gstrtpbin", "rtpbin", "gstrtpjitterbuffer", "rtpjitterbuffer"
+  };
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *name;
+  guint i;
+
+  if (!factory)
+    return FALSE;
+
+  name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    if (g_str_equal (name, names[i]))
+      return TRUE;
+
+  return FALSE;
 }
 
-static void
-set_current_audio (ClutterGstOverlayActor *self,
-                   gint                    stream)
+/* What a sink had before the live profile touched it */
+typedef struct {
+  gint64   max_lateness;
+  gboolean qos;
+} SinkDefaults;
+
+static GQuark
+sink_defaults_quark (void)
 {
-  set_pipeline_int_prop (self, "current-audio", stream);
+  return g_quark_from_static_string ("clutter-gst-overlay-sink-defaults");
 }
 
 static void
-set_current_video (ClutterGstOverlayActor *self,
-                   gint                    stream)
+sink_defaults_free (gpointer data)
 {
-  set_pipeline_int_prop (self, "current-video", stream);
+  g_slice_free (SinkDefaults, data);
 }
 
 static void
-set_audio_volume (ClutterGstOverlayActor *self,
-                  gdouble                 volume)
+restore_sink_defaults (GstElement *sink)
 {
-  g_object_set (G_OBJECT (self->priv->pipeline), "volume", volume, NULL);
-}
+  SinkDefaults *defaults = g_object_get_qdata (G_OBJECT (sink),
+                                               sink_defaults_quark ());
 
-static gdouble
-get_audio_volume (ClutterGstOverlayActor *self)
-{
-  gdouble volume = -1;
+  if (!defaults)
+    return;
 
-  g_object_get (G_OBJECT (self->priv->pipeline), "volume", &volume, NULL);
+  gst_base_sink_set_max_lateness (GST_BASE_SINK (sink), defaults->max_lateness);
+  gst_base_sink_set_qos_enabled (GST_BASE_SINK (sink), defaults->qos);
 
-  return volume;
+  g_object_set_qdata (G_OBJECT (sink), sink_defaults_quark (), NULL);
 }
 
 static void
-set_uri (ClutterGstOverlayActor *self,
-         const gchar            *uri)
+configure_live_element (ClutterGstOverlayActor *self,
+                        GstElement             *element)
 {
-  g_object_set (G_OBJECT (self->priv->pipeline), "uri", uri, NULL);
-}
+  GObjectClass *klass = G_OBJECT_GET_CLASS (element);
 
-static gchar *
-get_uri (ClutterGstOverlayActor *self)
-{
-  gchar *uri = NULL;
+  if (self->priv->latency_profile != CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE)
+    return;
 
-  g_object_get (G_OBJECT (self->priv->pipeline), "uri", &uri, NULL);
+  if (is_jitterbuffer (element))
+    g_object_set (G_OBJECT (element), "latency", LIVE_JITTER_LATENCY_MS, NULL);
 
-  return uri;
-}
+  if (g_object_class_find_property (klass, "max-size-time"))
+    g_object_set (G_OBJECT (element),
+                  "max-size-time", (guint64) LIVE_QUEUE_TIME,
+                  NULL);
 
-static gboolean
-test_uri (ClutterGstOverlayActor *self)
-{
-  gboolean result = FALSE;
+  if (g_object_class_find_property (klass, "use-buffering"))
+    g_object_set (G_OBJECT (element), "use-buffering", FALSE, NULL);
 
-  gchar *uri = get_uri (self);
+  if (GST_IS_BASE_SINK (element))
+    {
+      if (!g_object_get_qdata (G_OBJECT (element), sink_defaults_quark ()))
+        {
+          SinkDefaults *defaults = g_slice_new (SinkDefaults);
 
-  if (uri)
-    result = TRUE;
+          defaults->max_lateness =
+            gst_base_sink_get_max_lateness (GST_BASE_SINK (element));
+          defaults->qos = gst_base_sink_is_qos_enabled (GST_BASE_SINK (element));
 
-  g_free (uri);
+          g_object_set_qdata_full (G_OBJECT (element), sink_defaults_quark (),
+                                   defaults, sink_defaults_free);
+        }
 
-  return result;
+      gst_base_sink_set_max_lateness (GST_BASE_SINK (element),
+                                      LIVE_MAX_LATENESS);
+      gst_base_sink_set_qos_enabled (GST_BASE_SINK (element), TRUE);
+    }
 }
 
 static void
-set_playing (ClutterGstOverlayActor *self,
-             gboolean playing)
+update_latency (ClutterGstOverlayActor *self)
 {
-    GstStateChangeReturn state_change = 
-      gst_element_set_state (self->priv->pipeline,
-                             playing ? GST_STATE_PLAYING : GST_STATE_PAUSED);
+  GstQuery *query = gst_query_new_latency ();
+  GstClockTime min_latency;
+  gboolean live;
 
-    if (state_change == GST_STATE_CHANGE_FAILURE)
-      g_warning ("Unable to set playing\n");
+  if (gst_element_query (self->priv->pipeline, query))
+    {
+      gst_query_parse_latency (query, &live, &min_latency, NULL);
+      self->priv->latency = min_latency;
+    }
+
+  gst_query_unref (query);
 }
 
+/* Time between a frame's timestamp and its arrival at the sink, in
+ * running time. Live sources timestamp on capture, so this is what
+ * the pipeline adds on top of it.
+ */
 static gboolean
-get_playing (ClutterGstOverlayActor *self)
+latency_probe (GstPad    *pad,
+               GstBuffer *buffer,
+               gpointer   data)
 {
-  gboolean playing = FALSE;
-  GstState state, pending;
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+  GstClockTime ts = GST_BUFFER_TIMESTAMP (buffer);
+  GstClockTime now;
+  GstClock *clock;
 
-  gst_element_get_state (self->priv->pipeline, &state, &pending, 0);
+  if (priv->latency_profile != CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE ||
+      !GST_CLOCK_TIME_IS_VALID (ts))
+    return TRUE;
 
-  playing = pending ? (pending == GST_STATE_PLAYING) :
-                      (state   == GST_STATE_PLAYING);
+  clock = gst_element_get_clock (priv->pipeline);
 
-  return playing;
-}
+  if (!clock)
+    return TRUE;
 
-/* We can't get duration, set/get progress before main loop started */
+  now = gst_clock_get_time (clock) - gst_element_get_base_time (priv->pipeline);
+  gst_object_unref (clock);
 
-static gdouble
+  if (now > ts)
+    priv->measured_latency = GST_CLOCK_TIME_IS_VALID (priv->measured_latency) ?
+                             (priv->measured_latency * 7 + (now - ts)) / 8 :
+                             now - ts;
+
+  return TRUE;
+}
+
+static void
+add_latency_probe (ClutterGstOverlayActor *self,
+                   GstElement             *sink)
+{
+  GstPad *pad = gst_element_get_static_pad (sink, "sink");
+
+  gst_pad_add_buffer_probe (pad, G_CALLBACK (latency_probe), self);
+  gst_object_unref (pad);
+}
+
+static void
+set_latency_profile (ClutterGstOverlayActor          *self,
+                     ClutterGstOverlayLatencyProfile  profile)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstPlayFlags flags;
+
+  if (profile == priv->latency_profile)
+    return;
+
+  priv->latency_profile = profile;
+  priv->measured_latency = GST_CLOCK_TIME_NONE;
+
+  g_object_get (G_OBJECT (priv->pipeline), "flags", &flags, NULL);
+
+  /* Going back to the default gives back whatever live took away */
+  if (profile == CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE)
+    {
+      priv->live_saved_flags =
+        flags & (GST_PLAY_FLAG_BUFFERING | GST_PLAY_FLAG_DOWNLOAD);
+      flags &= ~(GST_PLAY_FLAG_BUFFERING | GST_PLAY_FLAG_DOWNLOAD);
+    }
+  else
+    {
+      flags |= priv->live_saved_flags;
+      priv->live_saved_flags = 0;
+    }
+
+  g_object_set (G_OBJECT (priv->pipeline),
+                "flags", flags,
+                "buffer-duration",
+                profile == CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE ?
+                (gint64) LIVE_QUEUE_TIME : (gint64) -1,
+                NULL);
+
+  /* Sinks exist up front, the rest is tuned as playbin2 creates it */
+  if (profile == CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE)
+    {
+      configure_live_element (self, priv->window_sink);
+
+      if (priv->texture_sink)
+        configure_live_element (self, priv->texture_sink);
+    }
+  else
+    {
+      restore_sink_defaults (priv->window_sink);
+
+      if (priv->texture_sink)
+        restore_sink_defaults (priv->texture_sink);
+    }
+}
+
+/* Inactive streams stay decoded and in sync behind the selector, so a
+ * switch only flips its active pad.
+ */
+static void
+configure_switch_element (ClutterGstOverlayActor *self,
+                          GstElement             *element)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *name;
+
+  if (!factory)
+    return;
+
+  name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+
+  if (g_str_equal (name, "input-selector") &&
+      g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+                                    "sync-streams"))
+    g_object_set (G_OBJECT (element), "sync-streams", TRUE, NULL);
+
+  if (g_str_equal (name, "textoverlay"))
+    {
+      g_mutex_lock (priv->frame_lock);
+
+      if (priv->text_overlay)
+        g_object_remove_weak_pointer (G_OBJECT (priv->text_overlay),
+                                      (gpointer *) &priv->text_overlay);
+
+      priv->text_overlay = element;
+      g_object_add_weak_pointer (G_OBJECT (element),
+                                 (gpointer *) &priv->text_overlay);
+      g_object_set (G_OBJECT (element),
+                    "silent", !priv->subtitles_visible, NULL);
+
+      g_mutex_unlock (priv->frame_lock);
+    }
+}
+
+/* playbin2 builds its decoders inside nested bins, so the handler
+ * follows every bin added below the pipeline.
+ */
+static void
+pipeline_element_added (GstBin     *bin,
+                        GstElement *element,
+                        gpointer    data)
+{
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+
+  if (GST_IS_BIN (element))
+    {
+      GstIterator *it;
+      gpointer child;
+
+      g_signal_connect (element, "element-added",
+                        G_CALLBACK (pipeline_element_added), self);
+
+      it = gst_bin_iterate_elements (GST_BIN (element));
+
+      while (gst_iterator_next (it, &child) == GST_ITERATOR_OK)
+        {
+          pipeline_element_added (GST_BIN (element), GST_ELEMENT (child), self);
+          gst_object_unref (child);
+        }
+
+      gst_iterator_free (it);
+    }
+
+  configure_decoder (self, element);
+  configure_queue (self, element);
+  configure_live_element (self, element);
+  configure_switch_element (self, element);
+}
+
+/* X requests. Nothing here waits for the server: serial ranges of
+ * the requests made for each actor are remembered, and the error
+ * handler charges errors to the actor that caused them when they
+ * arrive. A NULL actor marks requests of the library itself.
+ */
+#define X_RANGES 256
+
+typedef struct {
+  gulong                  first;
+  gulong                  last;
+  ClutterGstOverlayActor *actor;
+} XRequestRange;
+
+static XRequestRange  x_ranges[X_RANGES];
+static guint          x_range_next = 0;
+static XErrorHandler  previous_x_error_handler = NULL;
+static gboolean       x_error_handler_set = FALSE;
+static guint          x_requests = 0;
+static guint          frame_x_requests = 0;
+
+static int
+x_error_handler (Display     *display,
+                 XErrorEvent *event)
+{
+  guint i;
+
+  /* Serials are per connection; the sinks have their own */
+  if (display != clutter_x11_get_default_display ())
+    return previous_x_error_handler ?
+           previous_x_error_handler (display, event) : 0;
+
+  for (i = 0; i < X_RANGES; i++)
+    {
+      XRequestRange *range = &x_ranges[i];
+
+      if (range->first == 0 ||
+          event->serial < range->first || event->serial > range->last)
+        continue;
+
+      if (range->actor)
+        range->actor->priv->x_errors++;
+
+      return 0;
+    }
+
+  return previous_x_error_handler ?
+         previous_x_error_handler (display, event) : 0;
+}
+
+static gulong
+x_begin (Display *display)
+{
+  if (!x_error_handler_set)
+    {
+      previous_x_error_handler = XSetErrorHandler (x_error_handler);
+      x_error_handler_set = TRUE;
+    }
+
+  return NextRequest (display);
+}
+
+static void
+x_end (Display                *display,
+       gulong                  first,
+       ClutterGstOverlayActor *actor)
+{
+  gulong next = NextRequest (display);
+  XRequestRange *range;
+
+  if (next == first)
+    return;
+
+  range = &x_ranges[x_range_next++ % X_RANGES];
+  range->first = first;
+  range->last = next - 1;
+  range->actor = actor;
+
+  x_requests += next - first;
+}
+
+/* Later errors for a finalized actor are still swallowed */
+static void
+x_forget_actor (ClutterGstOverlayActor *actor)
+{
+  guint i;
+
+  for (i = 0; i < X_RANGES; i++)
+    if (x_ranges[i].actor == actor)
+      x_ranges[i].actor = NULL;
+}
+
+static void
+clutter_gst_overlay_actor_dispose (GObject *gobject)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (gobject)->priv;
+  GList *l;
+
+  g_static_mutex_lock (&actors_lock);
+
+  actors = g_list_remove (actors, gobject);
+
+  for (l = priv->decoders; l; l = l->next)
+    g_object_weak_unref (G_OBJECT (l->data), decoder_finalized, priv);
+
+  g_list_free (priv->decoders);
+  priv->decoders = NULL;
+
+  for (l = priv->queues; l; l = l->next)
+    g_object_weak_unref (G_OBJECT (l->data), queue_finalized, priv);
+
+  g_list_free (priv->queues);
+  priv->queues = NULL;
+
+  g_static_mutex_unlock (&actors_lock);
+
+  /* The others get this actor's share of the total */
+  if (total_memory_budget > 0)
+    rebalance_memory_budget ();
+
+  if (priv->pipeline)
+    {
+      cancel_recovery (CLUTTER_GST_OVERLAY_ACTOR (gobject));
+      stop_timeshift (CLUTTER_GST_OVERLAY_ACTOR (gobject));
+
+      gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+
+      gst_object_unref (GST_OBJECT (priv->pipeline));
+
+      priv->pipeline = NULL;
+    }
+
+  if (priv->audio_channel)
+    {
+      clutter_gst_overlay_audio_channel_free (priv->audio_channel);
+      priv->audio_channel = NULL;
+    }
+
+  if (priv->shared_window)
+    attach_shared_window (CLUTTER_GST_OVERLAY_ACTOR (gobject), NULL);
+
+  g_mutex_lock (priv->frame_lock);
+  remove_switch_probe_locked (priv);
+
+  if (priv->text_overlay)
+    g_object_remove_weak_pointer (G_OBJECT (priv->text_overlay),
+                                  (gpointer *) &priv->text_overlay);
+
+  priv->text_overlay = NULL;
+  g_mutex_unlock (priv->frame_lock);
+
+  if (priv->frame_cap_pad)
+    {
+      gst_pad_remove_buffer_probe (priv->frame_cap_pad, priv->frame_cap_probe);
+      g_signal_handler_disconnect (priv->frame_cap_pad, priv->frame_caps_handler);
+      gst_object_unref (priv->frame_cap_pad);
+
+      priv->frame_cap_pad = NULL;
+    }
+
+  if (priv->subtitle_bin)
+    {
+      gst_object_unref (priv->subtitle_bin);
+      priv->subtitle_bin = NULL;
+      priv->subtitle_overlay = NULL;
+    }
+
+  if (priv->subtitles)
+    {
+      clutter_gst_overlay_subtitles_unref (priv->subtitles);
+      priv->subtitles = NULL;
+    }
+
+  if (priv->window_sink)
+    {
+      gst_object_unref (priv->window_sink);
+      priv->window_sink = NULL;
+    }
+
+  if (priv->texture_sink)
+    {
+      gst_object_unref (priv->texture_sink);
+      priv->texture_sink = NULL;
+    }
+
+  if (priv->window_output)
+    {
+      gst_object_unref (priv->window_output);
+      priv->window_output = NULL;
+    }
+
+  if (priv->texture_output)
+    {
+      gst_object_unref (priv->texture_output);
+      priv->texture_output = NULL;
+    }
+
+  priv->video_sink = NULL;
+
+  G_OBJECT_CLASS (clutter_gst_overlay_actor_parent_class)->dispose (gobject);
+}
+
+static void
+clutter_gst_overlay_actor_finalize (GObject *gobject)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (gobject)->priv;
+  gulong first;
+
+  g_free (priv->font_name);
+
+  if (priv->snapshot_buffer)
+    gst_buffer_unref (priv->snapshot_buffer);
+
+  if (priv->snapshot_texture != COGL_INVALID_HANDLE)
+    cogl_handle_unref (priv->snapshot_texture);
+
+  if (priv->pending_frame)
+    gst_buffer_unref (priv->pending_frame);
+
+  if (priv->frame_textures[0] != COGL_INVALID_HANDLE)
+    cogl_handle_unref (priv->frame_textures[0]);
+
+  if (priv->frame_textures[1] != COGL_INVALID_HANDLE)
+    cogl_handle_unref (priv->frame_textures[1]);
+
+  cogl_handle_unref (priv->frame_material);
+
+  g_mutex_free (priv->frame_lock);
+  g_mutex_free (priv->timeshift_lock);
+
+  if (priv->tags)
+    gst_tag_list_free (priv->tags);
+
+  x_forget_actor (CLUTTER_GST_OVERLAY_ACTOR (gobject));
+
+  first = x_begin (priv->display);
+  XDestroyWindow (priv->display, priv->window);
+  x_end (priv->display, first, NULL);
+
+  G_OBJECT_CLASS (clutter_gst_overlay_actor_parent_class)->finalize (gobject);
+}
+
+static void
+clutter_gst_overlay_actor_show (ClutterActor *self,
+                                gpointer      user_data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  gulong first = x_begin (priv->display);
+
+  if (priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW &&
+      !priv->fully_clipped)
+    XMapWindow (priv->display, priv->window);
+
+  x_end (priv->display, first, CLUTTER_GST_OVERLAY_ACTOR (self));
+
+  if (priv->shared_window)
+    allocate_shared (CLUTTER_GST_OVERLAY_ACTOR (self));
+}
+
+static void
+clutter_gst_overlay_actor_hide (ClutterActor *self,
+                                gpointer      user_data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  gulong first;
+
+  if (priv->shared_window)
+    set_shared_rect (CLUTTER_GST_OVERLAY_ACTOR (self), NULL, 0, 0, 0, 0);
+
+  first = x_begin (priv->display);
+  XUnmapWindow (priv->display, priv->window);
+  x_end (priv->display, first, CLUTTER_GST_OVERLAY_ACTOR (self));
+}
+
+/* A fully clipped window still gets a frame now and then, so it
+ * prerolls and has something to show when uncovered.
+ */
+#define CLIPPED_FRAMERATE 1
+
+/* Small tiles do not need the full source rate */
+static gdouble
+get_auto_framerate (gfloat width,
+                    gfloat height)
+{
+  gfloat area = width * height;
+
+  if (area <= 320 * 240)
+    return 15;
+
+  if (area <= 640 * 360)
+    return 30;
+
+  return 0;
+}
+
+static void
+update_frame_cap (ClutterGstOverlayActor *self,
+                  gfloat                  width,
+                  gfloat                  height)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  gdouble framerate = priv->max_framerate;
+
+  if (priv->auto_framerate)
+    {
+      gdouble auto_framerate = get_auto_framerate (width, height);
+
+      if (auto_framerate > 0 && (framerate <= 0 || auto_framerate < framerate))
+        framerate = auto_framerate;
+    }
+
+  if (priv->fully_clipped)
+    framerate = CLIPPED_FRAMERATE;
+
+  /* Read by the probe on the streaming thread; no renegotiation needed */
+  priv->frame_interval = framerate > 0 ? GST_SECOND / framerate : 0;
+}
+
+#define SHARED_WINDOW_KEY "clutter-gst-overlay-shared-window"
+
+static SharedWindow *
+shared_window_ref (ClutterActor *stage,
+                   Display      *display)
+{
+  SharedWindow *shared = g_object_get_data (G_OBJECT (stage), SHARED_WINDOW_KEY);
+  XSetWindowAttributes attributes;
+  gulong first;
+  gfloat w, h;
+
+  if (shared)
+    {
+      shared->ref_count++;
+      return shared;
+    }
+
+  clutter_actor_get_size (stage, &w, &h);
+
+  attributes.background_pixel = BlackPixel (display, DefaultScreen (display));
+
+  shared = g_slice_new0 (SharedWindow);
+  shared->display = display;
+  shared->stage = stage;
+  shared->ref_count = 1;
+  shared->width = MAX (w, 1);
+  shared->height = MAX (h, 1);
+
+  first = x_begin (display);
+  shared->window = XCreateWindow (display,
+                                  clutter_x11_get_stage_window (CLUTTER_STAGE (stage)),
+                                  0, 0, shared->width, shared->height,
+                                  0, 0, 0, 0, CWBackPixel, &attributes);
+
+  /* Nothing is shown until an actor claims a rectangle */
+  XShapeCombineRectangles (display, shared->window, ShapeBounding,
+                           0, 0, NULL, 0, ShapeSet, Unsorted);
+  x_end (display, first, NULL);
+
+  g_object_set_data (G_OBJECT (stage), SHARED_WINDOW_KEY, shared);
+
+  return shared;
+}
+
+static void
+shared_window_unref (SharedWindow *shared)
+{
+  gulong first;
+
+  if (--shared->ref_count > 0)
+    return;
+
+  g_object_set_data (G_OBJECT (shared->stage), SHARED_WINDOW_KEY, NULL);
+
+  first = x_begin (shared->display);
+  XDestroyWindow (shared->display, shared->window);
+  x_end (shared->display, first, NULL);
+  g_list_free (shared->actors);
+
+  g_slice_free (SharedWindow, shared);
+}
+
+/* One shape request covers every actor on the stage */
+static void
+shared_window_update_shape (SharedWindow *shared)
+{
+  XRectangle *rects = g_new (XRectangle, g_list_length (shared->actors));
+  gint n = 0;
+  GList *l;
+
+  for (l = shared->actors; l; l = l->next)
+    {
+      ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (l->data)->priv;
+
+      if (priv->shared_rect.width > 0 && priv->shared_rect.height > 0)
+        rects[n++] = priv->shared_rect;
+    }
+
+  XShapeCombineRectangles (shared->display, shared->window, ShapeBounding,
+                           0, 0, rects, n, ShapeSet, Unsorted);
+
+  if ((n > 0) != shared->mapped)
+    {
+      shared->mapped = n > 0;
+
+      if (shared->mapped)
+        XMapWindow (shared->display, shared->window);
+      else
+        XUnmapWindow (shared->display, shared->window);
+    }
+
+  g_free (rects);
+}
+
+/* The sink renders the whole frame into @render, the shape shows
+ * the visible part, so a clipped actor is cropped rather than
+ * squeezed. @render is ignored while nothing is visible.
+ */
+static void
+set_shared_rect (ClutterGstOverlayActor *self,
+                 const XRectangle       *render,
+                 gint                    x,
+                 gint                    y,
+                 gint                    w,
+                 gint                    h)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  XRectangle old = priv->shared_rect;
+  gboolean moved = FALSE;
+  gulong first;
+
+  if (w > 0 && h > 0 && render)
+    {
+      moved = render->x != priv->shared_render.x ||
+              render->y != priv->shared_render.y ||
+              render->width != priv->shared_render.width ||
+              render->height != priv->shared_render.height;
+      priv->shared_render = *render;
+    }
+
+  if (!moved && old.x == x && old.y == y && old.width == w && old.height == h)
+    return;
+
+  priv->shared_rect.x = x;
+  priv->shared_rect.y = y;
+  priv->shared_rect.width = w;
+  priv->shared_rect.height = h;
+
+  if (moved)
+    gst_x_overlay_set_render_rectangle (GST_X_OVERLAY (priv->window_sink),
+                                        render->x, render->y,
+                                        render->width, render->height);
+
+  first = x_begin (priv->display);
+
+  if (old.width > 0 && old.height > 0)
+    XClearArea (priv->display, priv->shared_window->window,
+                old.x, old.y, old.width, old.height, False);
+
+  shared_window_update_shape (priv->shared_window);
+
+  x_end (priv->display, first, self);
+
+  if (w > 0 && h > 0)
+    gst_x_overlay_expose (GST_X_OVERLAY (priv->window_sink));
+}
+
+static void
+attach_shared_window (ClutterGstOverlayActor *self,
+                      ClutterActor           *stage)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  if (priv->shared_window && priv->shared_window->stage == stage)
+    return;
+
+  if (priv->shared_window)
+    {
+      set_shared_rect (self, NULL, 0, 0, 0, 0);
+      priv->shared_render.width = priv->shared_render.height = 0;
+      priv->shared_window->actors = g_list_remove (priv->shared_window->actors,
+                                                   self);
+      shared_window_unref (priv->shared_window);
+      priv->shared_window = NULL;
+    }
+
+  if (!stage)
+    return;
+
+  priv->shared_window = shared_window_ref (stage, priv->display);
+  priv->shared_window->actors = g_list_prepend (priv->shared_window->actors,
+                                                self);
+
+  gst_x_overlay_set_xwindow_id (GST_X_OVERLAY (priv->window_sink),
+                                priv->shared_window->window);
+}
+
+/* Intersects the actor's stage rectangle with the stage bounds and
+ * every ancestor clip, all in stage coordinates. Fullscreen actors
+ * cover the stage.
+ */
+static void
+get_visible_box (ClutterActor    *self,
+                 ClutterActorBox *box)
+{
+  ClutterActor *stage = clutter_actor_get_stage (self);
+  ClutterActor *parent;
+  gfloat w, h;
+
+  if (CLUTTER_GST_OVERLAY_ACTOR (self)->priv->fullscreen && stage)
+    {
+      clutter_actor_get_size (stage, &w, &h);
+      box->x1 = box->y1 = 0;
+      box->x2 = w;
+      box->y2 = h;
+      return;
+    }
+
+  clutter_actor_get_transformed_position (self, &box->x1, &box->y1);
+  clutter_actor_get_transformed_size (self, &w, &h);
+  box->x2 = box->x1 + w;
+  box->y2 = box->y1 + h;
+
+  if (stage)
+    {
+      clutter_actor_get_size (stage, &w, &h);
+      box->x1 = MAX (box->x1, 0);
+      box->y1 = MAX (box->y1, 0);
+      box->x2 = MIN (box->x2, w);
+      box->y2 = MIN (box->y2, h);
+    }
+
+  for (parent = clutter_actor_get_parent (self);
+       parent && parent != stage;
+       parent = clutter_actor_get_parent (parent))
+    {
+      ClutterVertex corners[2], clip[2];
+      gfloat cx, cy, cw, ch;
+
+      if (!clutter_actor_has_clip (parent))
+        continue;
+
+      clutter_actor_get_clip (parent, &cx, &cy, &cw, &ch);
+
+      corners[0].x = cx;
+      corners[0].y = cy;
+      corners[0].z = 0;
+      corners[1].x = cx + cw;
+      corners[1].y = cy + ch;
+      corners[1].z = 0;
+
+      clutter_actor_apply_transform_to_point (parent, &corners[0], &clip[0]);
+      clutter_actor_apply_transform_to_point (parent, &corners[1], &clip[1]);
+
+      box->x1 = MAX (box->x1, MIN (clip[0].x, clip[1].x));
+      box->y1 = MAX (box->y1, MIN (clip[0].y, clip[1].y));
+      box->x2 = MIN (box->x2, MAX (clip[0].x, clip[1].x));
+      box->y2 = MIN (box->y2, MAX (clip[0].y, clip[1].y));
+    }
+}
+
+/* Shapes the window to the visible part of the actor, talking to X
+ * only when that changes. A window with nothing visible is unmapped
+ * and its frames throttled.
+ */
+static void
+update_window_shape (ClutterActor *self,
+                     gfloat        x,
+                     gfloat        y,
+                     gfloat        w,
+                     gfloat        h)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  ClutterActorBox box;
+  XRectangle rect;
+  gboolean fully_clipped, shaped;
+
+  get_visible_box (self, &box);
+
+  fully_clipped = box.x2 <= box.x1 || box.y2 <= box.y1;
+
+  if (fully_clipped)
+    {
+      rect.x = rect.y = 0;
+      rect.width = rect.height = 0;
+    }
+  else
+    {
+      rect.x = box.x1 - x;
+      rect.y = box.y1 - y;
+      rect.width = box.x2 - box.x1;
+      rect.height = box.y2 - box.y1;
+    }
+
+  priv->clipped_pixels = w * h - rect.width * rect.height;
+
+  if (fully_clipped != priv->fully_clipped)
+    {
+      priv->fully_clipped = fully_clipped;
+      update_frame_cap (CLUTTER_GST_OVERLAY_ACTOR (self), w, h);
+
+      if (fully_clipped)
+        XUnmapWindow (priv->display, priv->window);
+      else if (CLUTTER_ACTOR_IS_VISIBLE (self))
+        XMapWindow (priv->display, priv->window);
+    }
+
+  if (fully_clipped || !priv->has_shape)
+    return;
+
+  shaped = rect.x != 0 || rect.y != 0 ||
+           rect.width < (gint) w || rect.height < (gint) h;
+
+  if (shaped == priv->shaped &&
+      (!shaped || memcmp (&rect, &priv->shape_rect, sizeof (rect)) == 0))
+    return;
+
+  if (shaped)
+    XShapeCombineRectangles (priv->display, priv->window, ShapeBounding,
+                             0, 0, &rect, 1, ShapeSet, Unsorted);
+  else
+    XShapeCombineMask (priv->display, priv->window, ShapeBounding,
+                       0, 0, None, ShapeSet);
+
+  priv->shaped = shaped;
+  priv->shape_rect = rect;
+}
+
+static guint x_flush_source = 0;
+
+static void
+flush_actor_x (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  gint64 trace_start = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
+  gulong first = x_begin (priv->display);
+
+  priv->x_dirty = FALSE;
+
+  if (priv->x_pending_parent != None)
+    {
+      XReparentWindow (priv->display, priv->window,
+                       priv->x_pending_parent, 0, 0);
+      priv->x_pending_parent = None;
+    }
+
+  if (priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW)
+    {
+      XMoveResizeWindow (priv->display, priv->window,
+                         priv->x_x, priv->x_y, priv->x_width, priv->x_height);
+
+      update_window_shape (CLUTTER_ACTOR (self), priv->x_x, priv->x_y,
+                           priv->x_width, priv->x_height);
+    }
+
+  x_end (priv->display, first, self);
+
+  if (priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW)
+    gst_x_overlay_expose (GST_X_OVERLAY (priv->window_sink));
+
+  CLUTTER_GST_OVERLAY_TRACE_END ("geometry", NULL, self, trace_start);
+}
+
+/* Runs once after the frame's layout, so every allocation of the
+ * frame ends up as one batch of requests and a single XFlush.
+ */
+static gboolean
+flush_x_requests (gpointer data)
+{
+  gint64 trace_start = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
+  GList *pending, *l;
+
+  x_flush_source = 0;
+
+  g_static_mutex_lock (&actors_lock);
+  pending = g_list_copy (actors);
+  g_static_mutex_unlock (&actors_lock);
+
+  for (l = pending; l; l = l->next)
+    if (CLUTTER_GST_OVERLAY_ACTOR (l->data)->priv->x_dirty)
+      flush_actor_x (CLUTTER_GST_OVERLAY_ACTOR (l->data));
+
+  g_list_free (pending);
+
+  XFlush (clutter_x11_get_default_display ());
+
+  frame_x_requests = x_requests;
+  x_requests = 0;
+
+  CLUTTER_GST_OVERLAY_TRACE_END ("x-flush", NULL, NULL, trace_start);
+
+  return FALSE;
+}
+
+static void
+queue_x_flush (ClutterGstOverlayActor *self)
+{
+  self->priv->x_dirty = TRUE;
+
+  if (!x_flush_source)
+    x_flush_source = clutter_threads_add_idle_full (CLUTTER_PRIORITY_REDRAW + 1,
+                                                    flush_x_requests,
+                                                    NULL, NULL);
+}
+
+/* Moving an actor is a render rectangle update and one shape request
+ * on the stage's window; no X window is moved or resized.
+ */
+static void
+allocate_shared (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  SharedWindow *shared = priv->shared_window;
+  ClutterActorBox box;
+  XRectangle render;
+  gfloat x, y, w, h;
+
+  if (!shared)
+    return;
+
+  clutter_actor_get_size (shared->stage, &w, &h);
+
+  if ((gint) w != shared->width || (gint) h != shared->height)
+    {
+      gulong first = x_begin (priv->display);
+
+      shared->width = MAX (w, 1);
+      shared->height = MAX (h, 1);
+      XResizeWindow (priv->display, shared->window,
+                     shared->width, shared->height);
+
+      x_end (priv->display, first, NULL);
+    }
+
+  if (!CLUTTER_ACTOR_IS_VISIBLE (self))
+    {
+      set_shared_rect (self, NULL, 0, 0, 0, 0);
+      return;
+    }
+
+  if (priv->fullscreen)
+    {
+      x = y = 0;
+    }
+  else
+    {
+      clutter_actor_get_transformed_position (CLUTTER_ACTOR (self), &x, &y);
+      clutter_actor_get_transformed_size (CLUTTER_ACTOR (self), &w, &h);
+    }
+
+  render.x = x;
+  render.y = y;
+  render.width = MAX (w, 1);
+  render.height = MAX (h, 1);
+
+  get_visible_box (CLUTTER_ACTOR (self), &box);
+
+  if (box.x2 <= box.x1 || box.y2 <= box.y1)
+    set_shared_rect (self, NULL, 0, 0, 0, 0);
+  else
+    set_shared_rect (self, &render, box.x1, box.y1,
+                     box.x2 - box.x1, box.y2 - box.y1);
+}
+
+static void
+clutter_gst_overlay_actor_allocate (ClutterActor *self,
+                                    ClutterActorBox *box,
+                                    ClutterAllocationFlags flags,
+                                    gpointer user_data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  ClutterActor *stage;
+  gfloat x, y, w, h;
+
+  stage = priv->fullscreen ? clutter_actor_get_stage (self) : NULL;
+
+  if (stage)
+    {
+      /* Pinned to the stage; where the actor is does not matter */
+      x = y = 0;
+      clutter_actor_get_size (stage, &w, &h);
+    }
+  else
+    {
+      clutter_actor_get_transformed_position (self, &x, &y);
+      clutter_actor_get_transformed_size (self, &w, &h);
+    }
+
+  update_frame_cap (CLUTTER_GST_OVERLAY_ACTOR (self), w, h);
+
+  if (priv->screen_area != w * h)
+    {
+      priv->screen_area = w * h;
+
+      if (decode_budget > 0)
+        rebalance_decoder_threads ();
+
+      select_video_stream (CLUTTER_GST_OVERLAY_ACTOR (self), w, h);
+      update_scale_caps (CLUTTER_GST_OVERLAY_ACTOR (self), w);
+    }
+
+  if (priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW)
+    {
+      allocate_shared (CLUTTER_GST_OVERLAY_ACTOR (self));
+      return;
+    }
+
+  /* Textures follow the scene graph on their own */
+  if (priv->render_mode != CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW)
+    return;
+
+  /* In XResizeWindow
+   * if either width or height is zero,
+   * a BadValue error results.
+   */
+  if (w <= 0)
+    w = 1;
+
+  if (h <= 0)
+    h = 1;
+
+  priv->x_x = x;
+  priv->x_y = y;
+  priv->x_width = w;
+  priv->x_height = h;
+
+  queue_x_flush (CLUTTER_GST_OVERLAY_ACTOR (self));
+}
+
+static void clutter_gst_overlay_actor_parent_set (ClutterActor *self,
+                                                  ClutterActor *old_parent,
+                                                  gpointer      user_data);
+
+/* We should track all parents for getting 'allocate' signal
+ * for correct allocating X window in stage coordinates
+ * when any parent moved and 'parent_set' signal
+ * for get 'allocate' signal from new parent of any parent.
+ * Without @all only the stage is tracked, for its size.
+ */
+static void
+track_ancestors (ClutterGstOverlayActor *self,
+                 gboolean                all)
+{
+  ClutterActor *parent;
+
+  for (parent = clutter_actor_get_parent (CLUTTER_ACTOR (self));
+       parent;
+       parent = clutter_actor_get_parent (parent))
+    {
+      g_signal_handlers_disconnect_by_func (parent,
+                                            clutter_gst_overlay_actor_parent_set,
+                                            self);
+      g_signal_handlers_disconnect_by_func (parent,
+                                            clutter_gst_overlay_actor_allocate,
+                                            self);
+
+      if (!all && !CLUTTER_IS_STAGE (parent))
+        continue;
+
+      g_signal_connect_swapped (parent, "parent-set",
+                                G_CALLBACK (clutter_gst_overlay_actor_parent_set),
+                                self);
+
+      g_signal_connect_swapped (parent, "allocation-changed",
+                                G_CALLBACK (clutter_gst_overlay_actor_allocate),
+                                self);
+    }
+}
+
+static void
+clutter_gst_overlay_actor_parent_set (ClutterActor *self,
+                                      ClutterActor *old_parent,
+                                      gpointer      user_data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  ClutterStage *stage_new_parent = CLUTTER_STAGE (clutter_actor_get_stage (self));
+
+  if (!CLUTTER_IS_STAGE (stage_new_parent))
+    return;
+
+  Window window_new_parent = clutter_x11_get_stage_window (stage_new_parent);
+
+  track_ancestors (CLUTTER_GST_OVERLAY_ACTOR (self), !priv->fullscreen);
+
+  if (priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW)
+    attach_shared_window (CLUTTER_GST_OVERLAY_ACTOR (self),
+                          CLUTTER_ACTOR (stage_new_parent));
+  else
+    {
+      priv->x_pending_parent = window_new_parent;
+      queue_x_flush (CLUTTER_GST_OVERLAY_ACTOR (self));
+    }
+
+  clutter_gst_overlay_actor_allocate (self, NULL, 0, NULL);
+}
+
+/* Maps the RGB layouts ximagesink negotiates onto Cogl formats,
+ * so a sink buffer can be uploaded as is.
+ */
+static gboolean
+get_cogl_format (GstCaps         *caps,
+                 CoglPixelFormat *cogl_format,
+                 gint            *width,
+                 gint            *height,
+                 gint            *rowstride)
+{
+  GstVideoFormat format;
+
+  if (!caps || !gst_video_format_parse_caps (caps, &format, width, height))
+    return FALSE;
+
+  switch (format)
+    {
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_RGBA:
+      *cogl_format = COGL_PIXEL_FORMAT_RGBA_8888;
+      break;
+
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_BGRA:
+      *cogl_format = COGL_PIXEL_FORMAT_BGRA_8888;
+      break;
+
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_ARGB:
+      *cogl_format = COGL_PIXEL_FORMAT_ARGB_8888;
+      break;
+
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_ABGR:
+      *cogl_format = COGL_PIXEL_FORMAT_ABGR_8888;
+      break;
+
+    case GST_VIDEO_FORMAT_RGB:
+      *cogl_format = COGL_PIXEL_FORMAT_RGB_888;
+      break;
+
+    case GST_VIDEO_FORMAT_BGR:
+      *cogl_format = COGL_PIXEL_FORMAT_BGR_888;
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  *rowstride = gst_video_format_get_row_stride (format, 0, *width);
+
+  return TRUE;
+}
+
+static CoglHandle
+texture_from_buffer (GstBuffer *buffer)
+{
+  CoglPixelFormat cogl_format;
+  gint width, height, rowstride;
+  GstBuffer *converted = NULL;
+  CoglHandle texture;
+
+  if (!get_cogl_format (GST_BUFFER_CAPS (buffer), &cogl_format,
+                        &width, &height, &rowstride))
+    {
+      /* Not an RGB layout Cogl takes directly, convert it once */
+      GstCaps *to_caps = gst_caps_from_string (GST_VIDEO_CAPS_RGBx);
+      GError *error = NULL;
+
+      converted = gst_video_convert_frame (buffer, to_caps,
+                                           GST_SECOND, &error);
+      gst_caps_unref (to_caps);
+
+      if (!converted)
+        {
+          g_warning ("Unable to convert snapshot: %s\n",
+                     error ? error->message : "unknown error");
+          g_clear_error (&error);
+          return COGL_INVALID_HANDLE;
+        }
+
+      buffer = converted;
+
+      if (!get_cogl_format (GST_BUFFER_CAPS (buffer), &cogl_format,
+                            &width, &height, &rowstride))
+        {
+          gst_buffer_unref (converted);
+          return COGL_INVALID_HANDLE;
+        }
+    }
+
+  texture = cogl_texture_new_from_data (width, height,
+                                        COGL_TEXTURE_NONE,
+                                        cogl_format,
+                                        COGL_PIXEL_FORMAT_RGB_888,
+                                        rowstride,
+                                        GST_BUFFER_DATA (buffer));
+
+  if (converted)
+    gst_buffer_unref (converted);
+
+  return texture;
+}
+
+static gboolean
+queue_frame_redraw (gpointer data)
+{
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+
+  g_mutex_lock (self->priv->frame_lock);
+  self->priv->redraw_queued = FALSE;
+  g_mutex_unlock (self->priv->frame_lock);
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
+
+  return FALSE;
+}
+
+/* Called on the streaming thread. Only the newest frame is kept:
+ * if the stage has not painted the previous one yet it is dropped.
+ */
+static void
+texture_sink_push_frame (ClutterGstOverlayActor *self,
+                         GstBuffer              *buffer)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  gboolean queue_redraw;
+
+  g_mutex_lock (priv->frame_lock);
+
+  if (priv->pending_frame)
+    {
+      gst_buffer_unref (priv->pending_frame);
+      priv->frames_skipped++;
+    }
+
+  priv->pending_frame = buffer;
+
+  queue_redraw = !priv->redraw_queued;
+  priv->redraw_queued = TRUE;
+
+  g_mutex_unlock (priv->frame_lock);
+
+  if (queue_redraw)
+    clutter_threads_add_idle_full (G_PRIORITY_DEFAULT, queue_frame_redraw,
+                                   g_object_ref (self), g_object_unref);
+}
+
+static GstFlowReturn
+texture_sink_new_preroll (GstAppSink *sink,
+                          gpointer    data)
+{
+  GstBuffer *buffer = gst_app_sink_pull_preroll (sink);
+
+  if (buffer)
+    texture_sink_push_frame (CLUTTER_GST_OVERLAY_ACTOR (data), buffer);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+texture_sink_new_buffer (GstAppSink *sink,
+                         gpointer    data)
+{
+  GstBuffer *buffer = gst_app_sink_pull_buffer (sink);
+
+  if (buffer)
+    texture_sink_push_frame (CLUTTER_GST_OVERLAY_ACTOR (data), buffer);
+
+  return GST_FLOW_OK;
+}
+
+/* Conversion cost, measured between the output bin's sink pad and
+ * the converter's src pad; both run in the same streaming thread.
+ */
+static gboolean
+convert_start_probe (GstPad    *pad,
+                     GstBuffer *buffer,
+                     gpointer   data)
+{
+  CLUTTER_GST_OVERLAY_ACTOR (data)->priv->convert_started = g_get_monotonic_time ();
+
+  return TRUE;
+}
+
+static gboolean
+convert_end_probe (GstPad    *pad,
+                   GstBuffer *buffer,
+                   gpointer   data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+  GstClockTime elapsed;
+
+  if (!priv->convert_started)
+    return TRUE;
+
+  elapsed = (g_get_monotonic_time () - priv->convert_started) * GST_USECOND;
+  priv->convert_started = 0;
+
+  priv->conversion_path =
+    !gst_base_transform_is_passthrough (GST_BASE_TRANSFORM (GST_PAD_PARENT (pad)));
+  priv->conversion_time = (priv->conversion_time * 7 + elapsed) / 8;
+
+  return TRUE;
+}
+
+/* videoscale ! capsfilter ! ffmpegcolorspace ! sink. playbin2 runs
+ * with NATIVE_VIDEO, so this is the only conversion: frames are
+ * downscaled to the actor first and the converter only touches what
+ * is shown. Both stay in passthrough in front of a sink that takes
+ * the decoder's format. Falls back to the bare sink.
+ */
+static GstElement *
+make_output_bin (ClutterGstOverlayActor *self,
+                 GstElement             *sink,
+                 const gchar            *name)
+{
+  GstElement *bin, *scale, *filter, *convert;
+  GstPad *pad;
+
+  scale   = gst_element_factory_make ("videoscale", NULL);
+  filter  = gst_element_factory_make ("capsfilter", "scale-filter");
+  convert = gst_element_factory_make ("ffmpegcolorspace", NULL);
+
+  if (!scale || !filter || !convert)
+    {
+      g_warning ("Unable to create video conversion, using the sink as is\n");
+
+      if (scale)
+        gst_object_unref (scale);
+      if (filter)
+        gst_object_unref (filter);
+      if (convert)
+        gst_object_unref (convert);
+
+      return gst_object_ref (sink);
+    }
+
+  bin = gst_bin_new (name);
+  gst_bin_add_many (GST_BIN (bin), scale, filter, convert, sink, NULL);
+  gst_element_link_many (scale, filter, convert, sink, NULL);
+
+  pad = gst_element_get_static_pad (scale, "sink");
+  gst_pad_add_buffer_probe (pad, G_CALLBACK (convert_start_probe), self);
+  gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+  gst_object_unref (pad);
+
+  pad = gst_element_get_static_pad (convert, "src");
+  gst_pad_add_buffer_probe (pad, G_CALLBACK (convert_end_probe), self);
+  gst_object_unref (pad);
+
+  return gst_object_ref_sink (bin);
+}
+
+/* Xv takes the decoders' YUV and scales in hardware, so nothing has
+ * to be converted. Whether Xv offers YUV at all is probed once, by the
+ * prewarm worker; until that is known the actors try Xv anyway. Every
+ * actor needs its own port, and one that cannot get it at playback
+ * falls back in use_fallback_window_sink.
+ */
+static gint native_window_sink = -1;
+
+/* Runs off the main thread: opening the display and querying the
+ * adaptors can take a while on a busy X server.
+ */
+static void
+probe_native_window_sink (void)
+{
+  GstElement *sink;
+  gint native = 0;
+
+  sink = gst_element_factory_make ("xvimagesink", NULL);
+
+  if (!sink)
+    {
+      g_atomic_int_set (&native_window_sink, 0);
+      return;
+    }
+
+  if (gst_element_set_state (sink, GST_STATE_READY) ==
+      GST_STATE_CHANGE_SUCCESS)
+    {
+      GstPad *pad = gst_element_get_static_pad (sink, "sink");
+      GstCaps *caps = gst_pad_get_caps (pad);
+      guint i;
+
+      for (i = 0; i < gst_caps_get_size (caps); i++)
+        if (gst_structure_has_name (gst_caps_get_structure (caps, i),
+                                    "video/x-raw-yuv"))
+          native = 1;
+
+      gst_caps_unref (caps);
+      gst_object_unref (pad);
+    }
+
+  gst_element_set_state (sink, GST_STATE_NULL);
+  gst_object_unref (sink);
+
+  g_atomic_int_set (&native_window_sink, native);
+}
+
+static GstElement *
+make_native_window_sink (void)
+{
+  GstElement *sink;
+
+  if (g_atomic_int_get (&native_window_sink) == 0)
+    return NULL;
+
+  sink = gst_element_factory_make ("xvimagesink", "window");
+
+  if (!sink)
+    g_atomic_int_set (&native_window_sink, 0);
+
+  return sink;
+}
+
+/* Downscaling only, by width, so videoscale keeps the aspect ratio.
+ * The width changes once it is off by more than SCALE_MARGIN.
+ */
+#define SCALE_MARGIN 1.25
+
+static void
+update_scale_caps (ClutterGstOverlayActor *self,
+                   gfloat                  width)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstElement *output, *filter;
+  GstCaps *caps;
+  gint video_width, target, old = priv->scale_width;
+
+  if (priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE)
+    output = priv->texture_output;
+  else
+    output = priv->window_scales ? priv->window_output : NULL;
+
+  if (!output || !GST_IS_BIN (output))
+    return;
+
+  g_mutex_lock (priv->frame_lock);
+  video_width = priv->video_width;
+  g_mutex_unlock (priv->frame_lock);
+
+  target = GST_ROUND_UP_4 ((gint) width);
+
+  if (video_width <= 0 || target <= 0 || target >= video_width)
+    target = 0;
+
+  if (old >= 0 &&
+      (target == old ||
+       (target && old && target < old * SCALE_MARGIN &&
+        target * SCALE_MARGIN > old)))
+    return;
+
+  filter = gst_bin_get_by_name (GST_BIN (output), "scale-filter");
+
+  if (!filter)
+    return;
+
+  if (target)
+    {
+      caps = gst_caps_new_simple ("video/x-raw-yuv",
+                                  "width", G_TYPE_INT, target, NULL);
+      gst_caps_append (caps, gst_caps_new_simple ("video/x-raw-rgb",
+                                                  "width", G_TYPE_INT, target,
+                                                  NULL));
+    }
+  else
+    caps = gst_caps_new_any ();
+
+  g_object_set (G_OBJECT (filter), "caps", caps, NULL);
+
+  gst_caps_unref (caps);
+  gst_object_unref (filter);
+
+  priv->scale_width = target;
+}
+
+static GstElement *
+make_texture_sink (ClutterGstOverlayActor *self)
+{
+  static GstAppSinkCallbacks callbacks = {
+    NULL,
+    texture_sink_new_preroll,
+    texture_sink_new_buffer,
+    NULL
+  };
+  GstElement *sink;
+  GstCaps *caps;
+
+  sink = gst_element_factory_make ("appsink", "texture");
+
+  if (!sink)
+    return NULL;
+
+  /* playsink converts to a layout Cogl uploads without swizzling */
+  caps = gst_caps_from_string (GST_VIDEO_CAPS_RGBx);
+  g_object_set (G_OBJECT (sink),
+                "caps", caps,
+                "sync", TRUE,
+                "max-buffers", 1,
+                "drop", TRUE,
+                "enable-last-buffer", TRUE,
+                NULL);
+  gst_caps_unref (caps);
+
+  gst_app_sink_set_callbacks (GST_APP_SINK (sink), &callbacks, self, NULL);
+
+  configure_live_element (self, sink);
+  add_latency_probe (self, sink);
+
+  return gst_object_ref_sink (sink);
+}
+
+/* Uploads into the texture that is not being shown, then flips,
+ * so the upload never waits for the GPU to finish with the front one.
+ */
+static void
+upload_frame (ClutterGstOverlayActor *self,
+              GstBuffer              *buffer)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  gint back = !priv->front_texture;
+  CoglHandle texture = priv->frame_textures[back];
+  CoglPixelFormat format;
+  gint width, height, rowstride;
+
+  if (!get_cogl_format (GST_BUFFER_CAPS (buffer), &format,
+                        &width, &height, &rowstride))
+    return;
+
+  if (texture != COGL_INVALID_HANDLE &&
+      cogl_texture_get_width (texture) == (guint)width &&
+      cogl_texture_get_height (texture) == (guint)height)
+    {
+      cogl_texture_set_region (texture, 0, 0, 0, 0,
+                               width, height, width, height,
+                               format, rowstride,
+                               GST_BUFFER_DATA (buffer));
+    }
+  else
+    {
+      if (texture != COGL_INVALID_HANDLE)
+        cogl_handle_unref (texture);
+
+      priv->frame_textures[back] = texture_from_buffer (buffer);
+
+      if (priv->frame_textures[back] == COGL_INVALID_HANDLE)
+        return;
+    }
+
+  priv->front_texture = back;
+  priv->frames_uploaded++;
+}
+
+static void
+clutter_gst_overlay_actor_paint_frame (ClutterActor *self,
+                                       gpointer      user_data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (self)->priv;
+  ClutterActorBox box;
+  CoglHandle texture;
+  GstBuffer *buffer;
+  guint8 opacity;
+
+  if (priv->render_mode != CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE)
+    return;
+
+  g_mutex_lock (priv->frame_lock);
+  buffer = priv->pending_frame;
+  priv->pending_frame = NULL;
+  g_mutex_unlock (priv->frame_lock);
+
+  if (buffer)
+    {
+      upload_frame (CLUTTER_GST_OVERLAY_ACTOR (self), buffer);
+      gst_buffer_unref (buffer);
+    }
+
+  texture = priv->frame_textures[priv->front_texture];
+
+  if (texture == COGL_INVALID_HANDLE)
+    return;
+
+  opacity = clutter_actor_get_paint_opacity (self);
+  clutter_actor_get_allocation_box (self, &box);
+
+  cogl_material_set_layer (priv->frame_material, 0, texture);
+  cogl_material_set_color4ub (priv->frame_material,
+                              opacity, opacity, opacity, opacity);
+  cogl_set_source (priv->frame_material);
+  cogl_rectangle (0, 0, box.x2 - box.x1, box.y2 - box.y1);
+}
+
+/* Streaming thread. Only looks the index up again once the frame
+ * leaves the span over which the current text stays valid.
+ */
+static gboolean
+subtitle_buffer_probe (GstPad    *pad,
+                       GstBuffer *buffer,
+                       gpointer   data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+  GstClockTime ts = GST_BUFFER_TIMESTAMP (buffer);
+  const gchar *text = NULL;
+  gboolean changed = FALSE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return TRUE;
+
+  g_mutex_lock (priv->frame_lock);
+
+  ts = gst_segment_to_stream_time (&priv->subtitle_segment,
+                                   GST_FORMAT_TIME, ts);
+
+  if (GST_CLOCK_TIME_IS_VALID (ts) &&
+      (!GST_CLOCK_TIME_IS_VALID (priv->cue_start) ||
+       ts < priv->cue_start || ts >= priv->cue_end))
+    {
+      if (priv->subtitles)
+        {
+          text = clutter_gst_overlay_subtitles_lookup (priv->subtitles, ts,
+                                                       &priv->cue_start,
+                                                       &priv->cue_end);
+        }
+      else
+        {
+          priv->cue_start = 0;
+          priv->cue_end = GST_CLOCK_TIME_NONE;
+        }
+
+      changed = TRUE;
+    }
+
+  /* The index owns the text and is kept alive while it is set */
+  if (changed)
+    g_object_set (G_OBJECT (priv->subtitle_overlay),
+                  "text", text ? text : "", NULL);
+
+  g_mutex_unlock (priv->frame_lock);
+
+  return TRUE;
+}
+
+static gboolean
+subtitle_event_probe (GstPad   *pad,
+                      GstEvent *event,
+                      gpointer  data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+  gboolean update;
+  gdouble rate, applied_rate;
+  GstFormat format;
+  gint64 start, stop, position;
+
+  switch (GST_EVENT_TYPE (event))
+    {
+    case GST_EVENT_NEWSEGMENT:
+      gst_event_parse_new_segment_full (event, &update, &rate, &applied_rate,
+                                        &format, &start, &stop, &position);
+
+      if (format != GST_FORMAT_TIME)
+        break;
+
+      g_mutex_lock (priv->frame_lock);
+      gst_segment_set_newsegment_full (&priv->subtitle_segment, update, rate,
+                                       applied_rate, format, start, stop,
+                                       position);
+      priv->cue_start = GST_CLOCK_TIME_NONE;
+      g_mutex_unlock (priv->frame_lock);
+      break;
+
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (priv->frame_lock);
+      gst_segment_init (&priv->subtitle_segment, GST_FORMAT_TIME);
+      priv->cue_start = GST_CLOCK_TIME_NONE;
+      g_mutex_unlock (priv->frame_lock);
+      break;
+
+    default:
+      break;
+    }
+
+  return TRUE;
+}
+
+/* Call while the pipeline is at most READY */
+static void
+set_subtitle_bin_sink (ClutterGstOverlayActor *self,
+                       GstElement             *sink)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstIterator *it;
+  gpointer child;
+
+  it = gst_bin_iterate_sinks (GST_BIN (priv->subtitle_bin));
+
+  while (gst_iterator_next (it, &child) == GST_ITERATOR_OK)
+    {
+      gst_element_unlink (priv->subtitle_overlay, GST_ELEMENT (child));
+      gst_bin_remove (GST_BIN (priv->subtitle_bin), GST_ELEMENT (child));
+      gst_object_unref (child);
+    }
+
+  gst_iterator_free (it);
+
+  gst_bin_add (GST_BIN (priv->subtitle_bin), sink);
+  gst_element_link (priv->subtitle_overlay, sink);
+}
+
+/* Puts a textoverlay fed from the index in front of the sink. Done
+ * once in init, before the sink belongs to a pipeline that has run.
+ */
+static gboolean
+make_subtitle_bin (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstElement *bin, *overlay;
+  GstObject *parent;
+  GstPad *pad;
+
+  parent = gst_object_get_parent (GST_OBJECT (priv->video_sink));
+
+  if (parent)
+    {
+      gst_object_unref (parent);
+      return FALSE;
+    }
+
+  overlay = gst_element_factory_make ("textoverlay", NULL);
+
+  if (!overlay)
+    return FALSE;
+
+  g_object_set (G_OBJECT (overlay),
+                "silent", !priv->subtitles_visible,
+                "wait-text", FALSE,
+                NULL);
+  gst_util_set_object_arg (G_OBJECT (overlay), "valignment", "bottom");
+
+  if (priv->font_name)
+    g_object_set (G_OBJECT (overlay), "font-desc", priv->font_name, NULL);
+
+  bin = gst_bin_new ("subtitles");
+  gst_bin_add (GST_BIN (bin), overlay);
+
+  pad = gst_element_get_static_pad (overlay, "video_sink");
+  gst_pad_add_buffer_probe (pad, G_CALLBACK (subtitle_buffer_probe), self);
+  gst_pad_add_event_probe (pad, G_CALLBACK (subtitle_event_probe), self);
+  gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+  gst_object_unref (pad);
+
+  priv->subtitle_bin = gst_object_ref_sink (bin);
+  priv->subtitle_overlay = overlay;
+
+  set_subtitle_bin_sink (self, priv->video_sink);
+
+  return TRUE;
+}
+
+/* playbin2 accepts a new video-sink only while it is not prerolled */
+static void
+set_render_mode (ClutterGstOverlayActor      *self,
+                 ClutterGstOverlayRenderMode  mode)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstState state;
+  gulong first;
+
+  if (mode == priv->render_mode)
+    return;
+
+  gst_element_get_state (priv->pipeline, &state, NULL, 0);
+
+  if (state > GST_STATE_READY)
+    {
+      g_warning ("Unable to change render mode while the pipeline is running\n");
+      return;
+    }
+
+  if (mode == CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE)
+    {
+      if (!priv->texture_sink)
+        {
+          priv->texture_sink = make_texture_sink (self);
+
+          if (priv->texture_sink)
+            priv->texture_output = make_output_bin (self, priv->texture_sink,
+                                                    "texture-output");
+        }
+
+      if (!priv->texture_sink)
+        {
+          g_warning ("Unable to create texture sink\n");
+          return;
+        }
+
+      priv->video_sink = priv->texture_output;
+      priv->fully_clipped = FALSE;
+
+      first = x_begin (priv->display);
+      XUnmapWindow (priv->display, priv->window);
+      x_end (priv->display, first, self);
+    }
+  else if (mode == CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW)
+    {
+      if (!priv->has_shape)
+        {
+          g_warning ("Shared window mode needs the X Shape extension\n");
+          return;
+        }
+
+      priv->video_sink = priv->window_output;
+      priv->fully_clipped = FALSE;
+
+      first = x_begin (priv->display);
+      XUnmapWindow (priv->display, priv->window);
+      x_end (priv->display, first, self);
+    }
+  else
+    {
+      priv->video_sink = priv->window_output;
+
+      if (CLUTTER_ACTOR_IS_VISIBLE (self))
+        {
+          first = x_begin (priv->display);
+          XMapWindow (priv->display, priv->window);
+          x_end (priv->display, first, self);
+        }
+    }
+
+  priv->render_mode = mode;
+  priv->scale_width = -1;
+  priv->conversion_path = FALSE;
+  priv->conversion_time = 0;
+
+  if (mode == CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW)
+    {
+      attach_shared_window (self, clutter_actor_get_stage (CLUTTER_ACTOR (self)));
+    }
+  else if (priv->shared_window)
+    {
+      attach_shared_window (self, NULL);
+      gst_x_overlay_set_render_rectangle (GST_X_OVERLAY (priv->window_sink),
+                                          -1, -1, -1, -1);
+      gst_x_overlay_set_xwindow_id (GST_X_OVERLAY (priv->window_sink),
+                                    priv->window);
+    }
+
+  if (priv->subtitle_bin)
+    set_subtitle_bin_sink (self, priv->video_sink);
+  else
+    g_object_set (G_OBJECT (priv->pipeline), "video-sink", priv->video_sink, NULL);
+
+  clutter_gst_overlay_actor_allocate (CLUTTER_ACTOR (self), NULL, 0, NULL);
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
+}
+
+static gint
+get_pipeline_int_prop (ClutterGstOverlayActor *self,
+                       const gchar            *prop)
+{
+  gint value = -1;
+
+  g_object_get (G_OBJECT (self->priv->pipeline), prop, &value, NULL);
+
+  return value;
+}
+
+static void
+set_pipeline_int_prop (ClutterGstOverlayActor *self,
+                       const gchar            *prop,
+                       gint                    value)
+{
+  g_object_set (G_OBJECT (self->priv->pipeline), prop, value, NULL);
+}
+
+static gint
+get_n_text (ClutterGstOverlayActor *self)
+{
+  return get_pipeline_int_prop (self, "n-text");
+}
+
+static gint
+get_n_audio (ClutterGstOverlayActor *self)
+{
+  return get_pipeline_int_prop (self, "n-audio");
+}
+
+static gint
+get_n_video (ClutterGstOverlayActor *self)
+{
+  return get_pipeline_int_prop (self, "n-video");
+}
+
+static gint
+get_current_text (ClutterGstOverlayActor *self)
+{
+  return get_pipeline_int_prop (self, "current-text");
+}
+
+static gint
+get_current_audio (ClutterGstOverlayActor *self)
+{
+  return get_pipeline_int_prop (self, "current-audio");
+}
+
+static gint
+get_current_video (ClutterGstOverlayActor *self)
+{
+  return get_pipeline_int_prop (self, "current-video");
+}
+
+static GstPad *get_pad (ClutterGstOverlayActor *self,
+                        const gchar            *type_of_pad,
+                        gint                    stream);
+
+/* Call with frame_lock held */
+static void
+remove_switch_probe_locked (ClutterGstOverlayActorPrivate *priv)
+{
+  if (!priv->switch_pad)
+    return;
+
+  gst_pad_remove_buffer_probe (priv->switch_pad, priv->switch_probe);
+  gst_object_unref (priv->switch_pad);
+  priv->switch_pad = NULL;
+}
+
+static gboolean
+switch_probe (GstPad    *pad,
+              GstBuffer *buffer,
+              gpointer   data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+
+  g_mutex_lock (priv->frame_lock);
+
+  if (pad == priv->switch_pad)
+    {
+      priv->last_switch_latency = (g_get_monotonic_time () -
+                                   priv->switch_started) * GST_USECOND;
+      remove_switch_probe_locked (priv);
+    }
+
+  g_mutex_unlock (priv->frame_lock);
+
+  return TRUE;
+}
+
+/* Flips the selector and times it until the first buffer of the new
+ * stream leaves the selector.
+ */
+static void
+switch_stream (ClutterGstOverlayActor *self,
+               const gchar            *type_of_pad,
+               const gchar            *prop,
+               gint                    stream)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstPad *pad = get_pad (self, type_of_pad, stream);
+  GstElement *selector = pad ? gst_pad_get_parent_element (pad) : NULL;
+  GstPad *src_pad = selector ? gst_element_get_static_pad (selector, "src") : NULL;
+
+  g_mutex_lock (priv->frame_lock);
+
+  remove_switch_probe_locked (priv);
+
+  if (src_pad)
+    {
+      priv->switch_pad = gst_object_ref (src_pad);
+      priv->switch_started = g_get_monotonic_time ();
+      priv->switch_probe = gst_pad_add_buffer_probe (src_pad,
+                                                     G_CALLBACK (switch_probe),
+                                                     self);
+    }
+
+  g_mutex_unlock (priv->frame_lock);
+
+  set_pipeline_int_prop (self, prop, stream);
+
+  if (src_pad)
+    gst_object_unref (src_pad);
+  if (selector)
+    gst_object_unref (selector);
+  if (pad)
+    gst_object_unref (pad);
+}
+
+static void
+set_current_text (ClutterGstOverlayActor *self,
+                  gint                    stream)
+{
+  switch_stream (self, "get-text-pad", "current-text", stream);
+}
+
+static void
+set_current_audio (ClutterGstOverlayActor *self,
+                   gint                    stream)
+{
+  switch_stream (self, "get-audio-pad", "current-audio", stream);
+}
+
+static void
+set_current_video (ClutterGstOverlayActor *self,
+                   gint                    stream)
+{
+  set_pipeline_int_prop (self, "current-video", stream);
+}
+
+/* A channel that is silent when loading does not decode audio at
+ * all. playsink only reads the flag when it reconfigures, so once
+ * prerolled a mute or unmute changes the mixer gain alone and the
+ * flag follows at the next load.
+ */
+static void
+update_audio_flag (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstPlayFlags flags, new_flags;
+  GstState state, pending;
+
+  gst_element_get_state (priv->pipeline, &state, &pending, 0);
+
+  if (MAX (state, pending) > GST_STATE_READY)
+    return;
+
+  g_object_get (G_OBJECT (priv->pipeline), "flags", &flags, NULL);
+
+  if (priv->audio_channel &&
+      (clutter_gst_overlay_audio_channel_get_mute (priv->audio_channel) ||
+       clutter_gst_overlay_audio_channel_get_volume (priv->audio_channel) <= 0))
+    new_flags = flags & ~GST_PLAY_FLAG_AUDIO;
+  else
+    new_flags = flags | GST_PLAY_FLAG_AUDIO;
+
+  if (new_flags != flags)
+    g_object_set (G_OBJECT (priv->pipeline), "flags", new_flags, NULL);
+}
+
+static void
+set_audio_volume (ClutterGstOverlayActor *self,
+                  gdouble                 volume)
+{
+  if (self->priv->audio_channel)
+    {
+      clutter_gst_overlay_audio_channel_set_volume (self->priv->audio_channel,
+                                                    volume);
+      update_audio_flag (self);
+      return;
+    }
+
+  g_object_set (G_OBJECT (self->priv->pipeline), "volume", volume, NULL);
+}
+
+static gdouble
+get_audio_volume (ClutterGstOverlayActor *self)
+{
+  gdouble volume = -1;
+
+  if (self->priv->audio_channel)
+    return clutter_gst_overlay_audio_channel_get_volume (self->priv->audio_channel);
+
+  g_object_get (G_OBJECT (self->priv->pipeline), "volume", &volume, NULL);
+
+  return volume;
+}
+
+/* Moves playbin2's own gain and mute into a mixer channel and back */
+static void
+set_shared_audio (ClutterGstOverlayActor *self,
+                  gboolean                shared)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  ClutterGstOverlayAudioChannel *channel;
+  gdouble volume;
+  gboolean mute;
+  GstState state;
+
+  if (shared == (priv->audio_channel != NULL))
+    return;
+
+  gst_element_get_state (priv->pipeline, &state, NULL, 0);
+
+  if (state > GST_STATE_READY)
+    {
+      g_warning ("Unable to change shared audio while the pipeline is running\n");
+      return;
+    }
+
+  if (shared)
+    {
+      channel = clutter_gst_overlay_audio_channel_new ();
+
+      if (!channel)
+        {
+          g_warning ("Unable to create shared audio channel\n");
+          return;
+        }
+
+      g_object_get (G_OBJECT (priv->pipeline),
+                    "volume", &volume, "mute", &mute, NULL);
+      clutter_gst_overlay_audio_channel_set_volume (channel, volume);
+      clutter_gst_overlay_audio_channel_set_mute (channel, mute);
+
+      g_object_set (G_OBJECT (priv->pipeline),
+                    "volume", 1.0,
+                    "mute", FALSE,
+                    "audio-sink", clutter_gst_overlay_audio_channel_get_sink (channel),
+                    NULL);
+
+      priv->audio_channel = channel;
+    }
+  else
+    {
+      channel = priv->audio_channel;
+
+      g_object_set (G_OBJECT (priv->pipeline),
+                    "audio-sink", NULL,
+                    "volume", clutter_gst_overlay_audio_channel_get_volume (channel),
+                    "mute", clutter_gst_overlay_audio_channel_get_mute (channel),
+                    NULL);
+
+      priv->audio_channel = NULL;
+      clutter_gst_overlay_audio_channel_free (channel);
+    }
+
+  update_audio_flag (self);
+}
+
+static void
+reset_media_info_cache (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  priv->cached_duration = GST_CLOCK_TIME_NONE;
+  priv->cached_can_seek = -1;
+
+  if (priv->tags)
+    gst_tag_list_free (priv->tags);
+
+  priv->tags = NULL;
+
+  g_mutex_lock (priv->frame_lock);
+  priv->video_width = priv->video_height = 0;
+  g_mutex_unlock (priv->frame_lock);
+}
+
+#define RECOVERY_BACKOFF     250
+#define RECOVERY_BACKOFF_MAX 4000
+
+enum {
+  RECOVERY_IDLE,
+  RECOVERY_WAITING,
+  RECOVERY_PREROLLING,
+  RECOVERY_SEEKING
+};
+
+static void
+cancel_recovery (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  if (priv->retry_source)
+    g_source_remove (priv->retry_source);
+
+  priv->retry_source = 0;
+  priv->recovery_phase = RECOVERY_IDLE;
+  priv->retry = 0;
+}
+
+/* What the restart has to get back to */
+static void
+save_recovery_point (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstFormat format = GST_FORMAT_TIME;
+  GstState state, pending;
+  gint64 position;
+
+  gst_element_get_state (priv->pipeline, &state, &pending, 0);
+
+  priv->recover_playing = pending ? (pending == GST_STATE_PLAYING) :
+                                    (state   == GST_STATE_PLAYING);
+  priv->recovery_started = g_get_monotonic_time ();
+  priv->recover_audio = get_current_audio (self);
+  priv->recover_text = get_current_text (self);
+
+  if (gst_element_query_position (priv->pipeline, &format, &position) &&
+      position >= 0)
+    priv->recover_position = position;
+  else
+    priv->recover_position = 0;
+}
+
+static void
+recovery_async_done (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  if (priv->recovery_phase == RECOVERY_PREROLLING)
+    {
+      priv->recovery_phase = RECOVERY_SEEKING;
+
+      /* The streams are known again once prerolled */
+      if (priv->recover_audio > 0)
+        set_pipeline_int_prop (self, "current-audio", priv->recover_audio);
+      if (priv->recover_text > 0)
+        set_pipeline_int_prop (self, "current-text", priv->recover_text);
+
+      if (priv->recover_position > 0 &&
+          gst_element_seek_simple (priv->pipeline, GST_FORMAT_TIME,
+                                   GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+                                   priv->recover_position))
+        return;
+    }
+
+  if (priv->recovery_phase != RECOVERY_SEEKING)
+    return;
+
+  if (priv->recover_playing)
+    gst_element_set_state (priv->pipeline, GST_STATE_PLAYING);
+
+  priv->states &= ~CLUTTER_GST_OVERLAY_STATE_LOADING;
+  priv->recovery_phase = RECOVERY_IDLE;
+  priv->retry = 0;
+  priv->recovery_count++;
+  priv->last_recovery_time = (g_get_monotonic_time () - priv->recovery_started) *
+                             GST_USECOND;
+}
+
+/* The seek back happens once the preroll is done */
+static void
+recovery_preroll (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  priv->recovery_phase = RECOVERY_PREROLLING;
+
+  if (priv->timeshift_ingest)
+    gst_element_set_state (priv->timeshift_ingest, GST_STATE_PLAYING);
+
+  if (gst_element_set_state (priv->pipeline, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_NO_PREROLL)
+    {
+      /* Live sources do not preroll and cannot seek back */
+      priv->recovery_phase = RECOVERY_SEEKING;
+      recovery_async_done (self);
+    }
+}
+
+/* Prerolls again with the same playbin2, sinks and window */
+static gboolean
+recovery_retry (gpointer data)
+{
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  priv->retry_source = 0;
+  priv->retry_count++;
+  recovery_preroll (self);
+
+  return FALSE;
+}
+
+/* Returns FALSE when the error should reach the application */
+static gboolean
+start_recovery (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  guint delay;
+
+  /* One failure usually posts several errors; the retry covers them */
+  if (priv->recovery_phase == RECOVERY_WAITING)
+    return TRUE;
+
+  if (priv->retry >= priv->max_retries)
+    return FALSE;
+
+  if (priv->recovery_phase == RECOVERY_IDLE)
+    save_recovery_point (self);
+
+  /* READY keeps the sinks and the X window, unlike NULL */
+  gst_element_set_state (priv->pipeline, GST_STATE_READY);
+
+  delay = MIN (RECOVERY_BACKOFF << MIN (priv->retry, 8), RECOVERY_BACKOFF_MAX);
+  priv->retry++;
+  priv->recovery_phase = RECOVERY_WAITING;
+  priv->states |= CLUTTER_GST_OVERLAY_STATE_LOADING;
+  priv->retry_source = g_timeout_add (delay, recovery_retry, self);
+
+  return TRUE;
+}
+
+/* Called when the native window sink failed, usually because the
+ * adaptor ran out of Xv ports. Swaps in ximagesink behind the usual
+ * scale and convert bin and prerolls again; the recovery steps then
+ * seek back and restore the streams.
+ */
+static gboolean
+use_fallback_window_sink (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstElement *sink, *old_sink, *old_output;
+  GstState target;
+  gfloat w, h;
+
+  if (priv->window_scales)
+    return FALSE;
+
+  sink = gst_element_factory_make ("ximagesink", "window");
+
+  if (!sink)
+    return FALSE;
+
+  target = GST_STATE_TARGET (priv->pipeline);
+
+  /* A failure during recovery keeps the point that recovery saved */
+  if (priv->recovery_phase == RECOVERY_IDLE && target >= GST_STATE_PAUSED)
+    save_recovery_point (self);
+
+  gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+
+  old_sink = priv->window_sink;
+  old_output = priv->window_output;
+
+  g_object_set (G_OBJECT (sink), "enable-last-buffer", TRUE, NULL);
+  add_latency_probe (self, sink);
+  configure_live_element (self, sink);
+
+  priv->window_sink = gst_object_ref_sink (sink);
+  priv->window_output = make_output_bin (self, sink, "window-output");
+  priv->window_scales = TRUE;
+  priv->scale_width = -1;
+
+  if (priv->video_sink == old_output)
+    {
+      priv->video_sink = priv->window_output;
+
+      if (priv->subtitle_bin)
+        set_subtitle_bin_sink (self, priv->video_sink);
+      else
+        g_object_set (G_OBJECT (priv->pipeline),
+                      "video-sink", priv->video_sink, NULL);
+    }
+
+  gst_object_unref (old_output);
+  gst_object_unref (old_sink);
+
+  if (priv->shared_window)
+    {
+      priv->shared_render.width = priv->shared_render.height = 0;
+      gst_x_overlay_set_xwindow_id (GST_X_OVERLAY (sink),
+                                    priv->shared_window->window);
+      allocate_shared (self);
+    }
+  else
+    gst_x_overlay_set_xwindow_id (GST_X_OVERLAY (sink), priv->window);
+
+  clutter_actor_get_transformed_size (CLUTTER_ACTOR (self), &w, &h);
+  update_scale_caps (self, w);
+
+  if (priv->recovery_phase != RECOVERY_IDLE || target >= GST_STATE_PAUSED)
+    {
+      if (priv->retry_source)
+        g_source_remove (priv->retry_source);
+
+      priv->retry_source = 0;
+      priv->states |= CLUTTER_GST_OVERLAY_STATE_LOADING;
+      recovery_preroll (self);
+    }
+  else if (target > GST_STATE_NULL)
+    gst_element_set_state (priv->pipeline, target);
+
+  return TRUE;
+}
+
+#define TIMESHIFT_READ_SIZE (64 * 1024)
+
+#define TIMESHIFT_NO_SEEK G_MAXUINT64
+
+/* The reader fell out of the window; the demuxer has to start over
+ * at the oldest data rather than be fed bytes that do not follow.
+ */
+static gboolean
+timeshift_resync (gpointer data)
+{
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+
+  if (self->priv->timeshift)
+    set_timeshift_progress (self, 0.0);
+
+  return FALSE;
+}
+
+/* Call with timeshift_lock held. At the live edge nothing is pushed
+ * and the ingest side pushes as soon as new data is written.
+ */
+static void
+timeshift_push_locked (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  guint64 offset = priv->timeshift_read_offset;
+  GstBuffer *buffer;
+  guint8 *data;
+  gssize size;
+
+  if (!priv->timeshift_src || priv->timeshift_resyncing)
+    return;
+
+  data = g_malloc (TIMESHIFT_READ_SIZE);
+  size = clutter_gst_overlay_timeshift_read (priv->timeshift, &offset,
+                                             data, TIMESHIFT_READ_SIZE);
+
+  if (size <= 0)
+    {
+      g_free (data);
+      priv->timeshift_starved = size == 0;
+
+      if (size < 0)
+        {
+          priv->timeshift_resyncing = TRUE;
+          clutter_threads_add_idle_full (G_PRIORITY_DEFAULT, timeshift_resync,
+                                         g_object_ref (self), g_object_unref);
+        }
+
+      return;
+    }
+
+  buffer = gst_buffer_new ();
+  GST_BUFFER_DATA (buffer) = GST_BUFFER_MALLOCDATA (buffer) = data;
+  GST_BUFFER_SIZE (buffer) = size;
+  GST_BUFFER_OFFSET (buffer) = offset - size;
+
+  priv->timeshift_read_offset = offset;
+  priv->timeshift_starved = FALSE;
+
+  gst_app_src_push_buffer (GST_APP_SRC (priv->timeshift_src), buffer);
+}
+
+static void
+timeshift_need_data (GstAppSrc *src,
+                     guint      length,
+                     gpointer   data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+
+  g_mutex_lock (priv->timeshift_lock);
+  timeshift_push_locked (CLUTTER_GST_OVERLAY_ACTOR (data));
+  g_mutex_unlock (priv->timeshift_lock);
+}
+
+/* A seek from set_timeshift_progress lands on the indexed offset for
+ * its time; the demuxer only estimates bytes from its own bitrate.
+ */
+static gboolean
+timeshift_seek_data (GstAppSrc *src,
+                     guint64    offset,
+                     gpointer   data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+
+  g_mutex_lock (priv->timeshift_lock);
+
+  if (priv->timeshift_seek_offset != TIMESHIFT_NO_SEEK)
+    {
+      offset = priv->timeshift_seek_offset;
+      priv->timeshift_seek_offset = TIMESHIFT_NO_SEEK;
+    }
+
+  priv->timeshift_read_offset = offset;
+  priv->timeshift_resyncing = FALSE;
+
+  g_mutex_unlock (priv->timeshift_lock);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+timeshift_ingest_new_buffer (GstAppSink *sink,
+                             gpointer    data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+  GstBuffer *buffer = gst_app_sink_pull_buffer (sink);
+
+  if (!buffer)
+    return GST_FLOW_UNEXPECTED;
+
+  clutter_gst_overlay_timeshift_write (priv->timeshift,
+                                       GST_BUFFER_DATA (buffer),
+                                       GST_BUFFER_SIZE (buffer),
+                                       g_get_monotonic_time () * GST_USECOND);
+  gst_buffer_unref (buffer);
+
+  g_mutex_lock (priv->timeshift_lock);
+
+  if (priv->timeshift_starved)
+    timeshift_push_locked (CLUTTER_GST_OVERLAY_ACTOR (data));
+
+  g_mutex_unlock (priv->timeshift_lock);
+
+  return GST_FLOW_OK;
+}
+
+static void
+source_notify_cb (GObject    *pipeline,
+                  GParamSpec *pspec,
+                  gpointer    data)
+{
+  static GstAppSrcCallbacks callbacks = {
+    timeshift_need_data,
+    NULL,
+    timeshift_seek_data
+  };
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstElement *source = NULL;
+
+  g_object_get (pipeline, "source", &source, NULL);
+
+  if (!source)
+    return;
+
+  if (priv->timeshift && GST_IS_APP_SRC (source))
+    {
+      gst_app_src_set_stream_type (GST_APP_SRC (source),
+                                   GST_APP_STREAM_TYPE_RANDOM_ACCESS);
+      gst_app_src_set_callbacks (GST_APP_SRC (source), &callbacks, self, NULL);
+
+      g_mutex_lock (priv->timeshift_lock);
+
+      if (priv->timeshift_src)
+        gst_object_unref (priv->timeshift_src);
+
+      priv->timeshift_src = gst_object_ref (source);
+      priv->timeshift_starved = FALSE;
+
+      g_mutex_unlock (priv->timeshift_lock);
+    }
+
+  gst_object_unref (source);
+}
+
+/* Ingest errors go through the same recovery as playback errors;
+ * recovery_retry starts the ingest again with the ring intact.
+ */
+static gboolean
+timeshift_bus_call (GstBus     *bus,
+                    GstMessage *msg,
+                    gpointer    data)
+{
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+  GError *error;
+  gchar *debug;
+
+  if (GST_MESSAGE_TYPE (msg) != GST_MESSAGE_ERROR)
+    return TRUE;
+
+  gst_message_parse_error (msg, &error, &debug);
+  g_free (debug);
+
+  gst_element_set_state (self->priv->timeshift_ingest, GST_STATE_NULL);
+
+  if (!start_recovery (self))
+    {
+      cancel_recovery (self);
+      gst_element_set_state (self->priv->pipeline, GST_STATE_NULL);
+      g_signal_emit_by_name (self, "error", error);
+    }
+
+  g_error_free (error);
+
+  return TRUE;
+}
+
+/* The ring holds a byte stream that playbin2 typefinds again. Bins
+ * with sometimes pads such as rtspsrc, and sources of RTP packets,
+ * have nothing a reader could parse once concatenated.
+ */
+static gboolean
+is_bytestream_source (GstElement *source)
+{
+  GstPad *pad;
+  GstCaps *caps;
+  gboolean result = TRUE;
+  guint i;
+
+  if (!GST_IS_BASE_SRC (source))
+    return FALSE;
+
+  pad = gst_element_get_static_pad (source, "src");
+
+  if (!pad)
+    return FALSE;
+
+  caps = gst_pad_get_caps (pad);
+
+  for (i = 0; i < gst_caps_get_size (caps); i++)
+    if (g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps, i)),
+                          "application/x-rtp"))
+      result = FALSE;
+
+  gst_caps_unref (caps);
+  gst_object_unref (pad);
+
+  return result;
+}
+
+static void
+stop_timeshift (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  if (!priv->timeshift)
+    return;
+
+  g_source_remove (priv->timeshift_watch);
+  priv->timeshift_watch = 0;
+
+  /* Stops the appsrc thread before the ring goes away */
+  gst_element_set_state (priv->pipeline, GST_STATE_READY);
+  gst_element_set_state (priv->timeshift_ingest, GST_STATE_NULL);
+
+  gst_object_unref (priv->timeshift_ingest);
+  priv->timeshift_ingest = NULL;
+
+  if (priv->timeshift_src)
+    {
+      gst_object_unref (priv->timeshift_src);
+      priv->timeshift_src = NULL;
+    }
+
+  clutter_gst_overlay_timeshift_free (priv->timeshift);
+  priv->timeshift = NULL;
+
+  g_free (priv->timeshift_uri);
+  priv->timeshift_uri = NULL;
+}
+
+static gboolean
+start_timeshift (ClutterGstOverlayActor *self,
+                 const gchar            *uri)
+{
+  static GstAppSinkCallbacks callbacks = {
+    NULL,
+    NULL,
+    timeshift_ingest_new_buffer,
+    NULL
+  };
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstElement *source, *sink;
+  GError *error = NULL;
+  GstBus *bus;
+
+  source = gst_element_make_from_uri (GST_URI_SRC, uri, NULL);
+
+  if (!source)
+    {
+      g_warning ("Unable to create timeshift source for %s\n", uri);
+      return FALSE;
+    }
+
+  if (!is_bytestream_source (source))
+    {
+      g_warning ("Timeshift needs a byte stream source, playing %s live\n",
+                 uri);
+      gst_object_unref (source);
+      return FALSE;
+    }
+
+  priv->timeshift = clutter_gst_overlay_timeshift_new (NULL,
+                                                       priv->timeshift_size,
+                                                       &error);
+
+  if (!priv->timeshift)
+    {
+      g_warning ("Unable to create timeshift buffer: %s\n", error->message);
+      g_error_free (error);
+      gst_object_unref (source);
+      return FALSE;
+    }
+
+  sink = gst_element_factory_make ("appsink", NULL);
+  g_object_set (G_OBJECT (sink), "sync", FALSE, NULL);
+  gst_app_sink_set_callbacks (GST_APP_SINK (sink), &callbacks, self, NULL);
+
+  priv->timeshift_ingest = gst_pipeline_new ("timeshift-ingest");
+  gst_bin_add_many (GST_BIN (priv->timeshift_ingest), source, sink, NULL);
+
+  gst_element_link (source, sink);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (priv->timeshift_ingest));
+  priv->timeshift_watch = gst_bus_add_watch (bus, timeshift_bus_call, self);
+  gst_object_unref (bus);
+
+  priv->timeshift_uri = g_strdup (uri);
+  priv->timeshift_read_offset = 0;
+  priv->timeshift_resyncing = FALSE;
+  priv->timeshift_seek_offset = TIMESHIFT_NO_SEEK;
+  priv->timeshift_epoch = g_get_monotonic_time () * GST_USECOND;
+
+  gst_element_set_state (priv->timeshift_ingest, GST_STATE_PLAYING);
+
+  g_object_set (G_OBJECT (priv->pipeline), "uri", "appsrc://", NULL);
+
+  return TRUE;
+}
+
+static void
+set_uri (ClutterGstOverlayActor *self,
+         const gchar            *uri)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  cancel_recovery (self);
+  stop_timeshift (self);
+  update_audio_flag (self);
+  priv->recover_position = 0;
+  reset_media_info_cache (self);
+
+  /* Both end on their own: at async-done and at the first frame */
+  priv->trace_preroll = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
+
+  g_mutex_lock (priv->frame_lock);
+  priv->trace_first_frame = priv->trace_preroll;
+  g_mutex_unlock (priv->frame_lock);
+
+  if (uri && self->priv->timeshift_size > 0 && start_timeshift (self, uri))
+    return;
+
+  g_object_set (G_OBJECT (self->priv->pipeline), "uri", uri, NULL);
+}
+
+static gchar *
+get_uri (ClutterGstOverlayActor *self)
+{
+  gchar *uri = NULL;
+
+  if (self->priv->timeshift)
+    return g_strdup (self->priv->timeshift_uri);
+
+  g_object_get (G_OBJECT (self->priv->pipeline), "uri", &uri, NULL);
+
+  return uri;
+}
+
+/* Position inside the timeshift window, 0 oldest and 1 live */
+static gdouble
+get_timeshift_progress (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstClockTime start, end, time;
+  guint64 offset;
+
+  g_mutex_lock (priv->timeshift_lock);
+  offset = priv->timeshift_read_offset;
+  g_mutex_unlock (priv->timeshift_lock);
+
+  clutter_gst_overlay_timeshift_get_window (priv->timeshift, NULL, NULL,
+                                            &start, &end);
+  time = clutter_gst_overlay_timeshift_get_time_at_offset (priv->timeshift,
+                                                           offset);
+
+  if (!GST_CLOCK_TIME_IS_VALID (start) || end <= start ||
+      !GST_CLOCK_TIME_IS_VALID (time))
+    return 1.0;
+
+  return CLAMP ((gdouble)(time - start) / (end - start), 0.0, 1.0);
+}
+
+/* Demuxers only take TIME seeks. Stream time runs from the start of
+ * the ingest, and the byte seek the demuxer sends upstream is moved
+ * to the indexed offset in timeshift_seek_data.
+ */
+static void
+set_timeshift_progress (ClutterGstOverlayActor *self,
+                        gdouble                 progress)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstClockTime start, end, time;
+
+  clutter_gst_overlay_timeshift_get_window (priv->timeshift, NULL, NULL,
+                                            &start, &end);
+
+  if (!GST_CLOCK_TIME_IS_VALID (start))
+    return;
+
+  time = start + progress * (end - start);
+
+  g_mutex_lock (priv->timeshift_lock);
+  priv->timeshift_seek_offset =
+    clutter_gst_overlay_timeshift_get_offset_at_time (priv->timeshift, time);
+  g_mutex_unlock (priv->timeshift_lock);
+
+  if (!gst_element_seek_simple (priv->pipeline, GST_FORMAT_TIME,
+                                GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+                                time > priv->timeshift_epoch ?
+                                time - priv->timeshift_epoch : 0))
+    {
+      g_mutex_lock (priv->timeshift_lock);
+      priv->timeshift_seek_offset = TIMESHIFT_NO_SEEK;
+      g_mutex_unlock (priv->timeshift_lock);
+
+      g_warning ("Unable to set timeshift progress\n");
+    }
+}
+
+static gboolean
+test_uri (ClutterGstOverlayActor *self)
+{
+  gboolean result = FALSE;
+
+  gchar *uri = get_uri (self);
+
+  if (uri)
+    result = TRUE;
+
+  g_free (uri);
+
+  return result;
+}
+
+static void
+set_playing (ClutterGstOverlayActor *self,
+             gboolean playing)
+{
+    gint64 trace_start = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
+    GstStateChangeReturn state_change = 
+      gst_element_set_state (self->priv->pipeline,
+                             playing ? GST_STATE_PLAYING : GST_STATE_PAUSED);
+
+    if (state_change == GST_STATE_CHANGE_FAILURE)
+      g_warning ("Unable to set playing\n");
+
+    CLUTTER_GST_OVERLAY_TRACE_END ("set-playing", playing ? "playing" : "paused",
+                                   self, trace_start);
+}
+
+static gboolean
+get_playing (ClutterGstOverlayActor *self)
+{
+  gboolean playing = FALSE;
+  GstState state, pending;
+
+  gst_element_get_state (self->priv->pipeline, &state, &pending, 0);
+
+  playing = pending ? (pending == GST_STATE_PLAYING) :
+                      (state   == GST_STATE_PLAYING);
+
+  return playing;
+}
+
+/* We can't get duration, set/get progress before main loop started */
+
+static gdouble
 get_duration (ClutterGstOverlayActor *self)
 {
   gint64 duration = -1;
   gboolean result;
   GstFormat format = GST_FORMAT_TIME;
 
+  if (self->priv->timeshift)
+    {
+      GstClockTime start, end;
+
+      clutter_gst_overlay_timeshift_get_window (self->priv->timeshift,
+                                                NULL, NULL, &start, &end);
+
+      return GST_CLOCK_TIME_IS_VALID (start) ? (gdouble)(end - start) : 0;
+    }
+
   result = gst_element_query_duration (self->priv->pipeline, &format, &duration);
 
   if (!result)
@@ -397,7 +3606,12 @@ static void
 set_progress (ClutterGstOverlayActor *self,
               gdouble                 progress)
 {
-  if (test_uri (self))
+  /* Ends at async-done */
+  self->priv->trace_seek = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
+
+  if (self->priv->timeshift)
+    set_timeshift_progress (self, progress);
+  else if (test_uri (self))
     {
       gboolean result;
 
@@ -420,112 +3634,554 @@ get_progress (ClutterGstOverlayActor *self)
   gboolean result;
   GstFormat format = GST_FORMAT_TIME;
 
-  result = gst_element_query_position (self->priv->pipeline, &format, &progress);
+  if (self->priv->timeshift)
+    return get_timeshift_progress (self);
+
+  result = gst_element_query_position (self->priv->pipeline, &format, &progress);
+
+  if (!result)
+    {
+      g_warning ("Unable to get progress\n");
+      return -1;
+    }
+
+  if (format != GST_FORMAT_TIME)
+    {
+      g_warning ("It is not format of the progress\n");
+      return -1;
+    }
+
+  return (gdouble)progress / get_duration (self);
+}
+
+static void
+set_subtitles_index (ClutterGstOverlayActor     *self,
+                     ClutterGstOverlaySubtitles *subtitles)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  ClutterGstOverlaySubtitles *old;
+
+  g_mutex_lock (priv->frame_lock);
+
+  old = priv->subtitles;
+  priv->subtitles = subtitles;
+  priv->cue_start = GST_CLOCK_TIME_NONE;
+
+  if (priv->subtitle_overlay)
+    g_object_set (G_OBJECT (priv->subtitle_overlay), "text", "", NULL);
+
+  g_mutex_unlock (priv->frame_lock);
+
+  if (old)
+    clutter_gst_overlay_subtitles_unref (old);
+}
+
+/* SubRip files are parsed once into a shared index and drawn by the
+ * actor's own textoverlay, so seeks and toggles show the right cue
+ * on the next frame. Other formats, or an actor without textoverlay,
+ * go through playbin2's suburi as before.
+ */
+static void
+set_subtitle_uri (ClutterGstOverlayActor *self,
+                  const gchar            *uri)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  ClutterGstOverlaySubtitles *subtitles = NULL;
+  GError *error = NULL;
+
+  if (uri && priv->subtitle_bin && clutter_gst_overlay_subtitles_supports (uri))
+    {
+      subtitles = clutter_gst_overlay_subtitles_get (uri, &error);
+
+      if (!subtitles)
+        {
+          g_warning ("Unable to index subtitles: %s\n", error->message);
+          g_error_free (error);
+        }
+    }
+
+  set_subtitles_index (self, subtitles);
+
+  g_object_set (G_OBJECT (priv->pipeline),
+                "suburi", subtitles ? NULL : uri, NULL);
+}
+
+static gchar *
+get_subtitle_uri (ClutterGstOverlayActor *self)
+{
+  gchar *uri = NULL;
+
+  if (self->priv->subtitles)
+    return g_strdup (clutter_gst_overlay_subtitles_get_uri (self->priv->subtitles));
+
+  g_object_get (G_OBJECT (self->priv->pipeline), "suburi", &uri, NULL);
+
+  return uri;
+}
+
+static void
+set_subtitle_font_name (ClutterGstOverlayActor *self,
+                        const gchar            *font_name)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+
+  g_free (priv->font_name);
+
+  priv->font_name = g_strdup (font_name);
+
+  g_object_set (G_OBJECT (priv->pipeline),
+                "subtitle-font-desc", font_name,
+                NULL);
+
+  if (priv->subtitle_overlay)
+    g_object_set (G_OBJECT (priv->subtitle_overlay),
+                  "font-desc", font_name, NULL);
+}
+
+static gchar *
+get_subtitle_font_name (ClutterGstOverlayActor *self)
+{
+  return g_strdup (self->priv->font_name);
+}
+
+static gdouble
+get_buffer_fill (ClutterGstOverlayActor *self)
+{
+  return self->priv->buffer_fill;
+}
+
+static gboolean
+get_can_seek (ClutterGstOverlayActor *self)
+{
+  gboolean can_seek = FALSE;
+  GstQuery *seeking = gst_query_new_seeking (GST_FORMAT_TIME);
+
+  if (gst_element_query (self->priv->pipeline, seeking))
+    gst_query_parse_seeking (seeking, NULL, &can_seek, NULL, NULL);
+
+  gst_query_unref (seeking);
+
+  return can_seek;
+}
+
+static GstPad*
+get_pad (ClutterGstOverlayActor *self,
+         const gchar            *type_of_pad,
+         gint                    stream)
+{
+  GstPad *pad = NULL;
+
+  g_signal_emit_by_name (self->priv->pipeline, type_of_pad, stream, &pad);
+
+  return pad;
+}
+
+static GstPad*
+get_text_pad (ClutterGstOverlayActor *self,
+              gint                    stream)
+{
+  return get_pad (self, "get-text-pad", stream);
+}
+
+static GstPad*
+get_audio_pad (ClutterGstOverlayActor *self,
+               gint                    stream)
+{
+  return get_pad (self, "get-audio-pad", stream);
+}
+
+static GstPad*
+get_video_pad (ClutterGstOverlayActor *self,
+               gint                    stream)
+{
+  return get_pad (self, "get-video-pad", stream);
+}
+
+/* A stream is only replaced by a smaller one that still covers the
+ * actor with this much to spare, so resizing around a stream's size
+ * does not flip between two of them.
+ */
+#define SELECT_MARGIN 1.25
+
+/* Rough encoder rate for a frame area, in kbit/s */
+#define KBPS_PER_PIXEL 0.003
+#define MIN_CONNECTION_SPEED 256
+
+static gboolean
+get_video_stream_info (ClutterGstOverlayActor *self,
+                       gint                    stream,
+                       gint                   *width,
+                       gint                   *height,
+                       guint                  *bitrate)
+{
+  GstPad *pad = get_video_pad (self, stream);
+  GstTagList *tags = NULL;
+  GstCaps *caps;
+  gboolean result = FALSE;
+
+  if (!pad)
+    return FALSE;
+
+  caps = gst_pad_get_negotiated_caps (pad);
+  gst_object_unref (pad);
+
+  if (caps)
+    {
+      result = gst_video_format_parse_caps (caps, NULL, width, height);
+      gst_caps_unref (caps);
+    }
+
+  *bitrate = 0;
+
+  g_signal_emit_by_name (self->priv->pipeline, "get-video-tags",
+                         stream, &tags);
+
+  if (tags)
+    {
+      if (!gst_tag_list_get_uint (tags, GST_TAG_BITRATE, bitrate))
+        gst_tag_list_get_uint (tags, GST_TAG_NOMINAL_BITRATE, bitrate);
+
+      gst_tag_list_free (tags);
+    }
+
+  return result;
+}
+
+/* Adaptive sources pick their variant from the connection speed,
+ * which is capped to what the actor can show.
+ */
+static void
+update_connection_speed (ClutterGstOverlayActor *self,
+                         gfloat                  width,
+                         gfloat                  height)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  guint speed = 0, old = priv->connection_speed;
+
+  if (priv->auto_video)
+    speed = MAX (width * height * KBPS_PER_PIXEL, MIN_CONNECTION_SPEED);
+
+  if (speed == old ||
+      (speed && old && speed < old * SELECT_MARGIN &&
+       speed * SELECT_MARGIN > old))
+    return;
+
+  priv->connection_speed = speed;
+  g_object_set (G_OBJECT (priv->pipeline), "connection-speed", speed, NULL);
+}
+
+/* Picks the smallest video stream covering the actor on screen, or
+ * the largest when none does. playbin2 keeps decoding every stream
+ * behind the selector, so this only saves scaling and drawing; only
+ * connection-speed saves bandwidth and decoding.
+ */
+static void
+select_video_stream (ClutterGstOverlayActor *self,
+                     gfloat                  width,
+                     gfloat                  height)
+{
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  gint n, i, current, best = -1;
+  gint best_area = 0, current_area = 0, largest_area = 0;
+  guint best_bitrate = 0, current_bitrate = 0, largest_bitrate = 0;
+  gboolean best_covers = FALSE, best_spare = FALSE, current_covers = FALSE;
+
+  update_connection_speed (self, width, height);
+
+  if (!priv->auto_video)
+    return;
+
+  n = get_n_video (self);
+  current = get_current_video (self);
+
+  for (i = 0; i < n; i++)
+    {
+      gint w, h, area;
+      guint bitrate;
+      gboolean covers;
+
+      if (!get_video_stream_info (self, i, &w, &h, &bitrate))
+        continue;
+
+      area = w * h;
+      covers = w >= width && h >= height;
+
+      largest_area = MAX (largest_area, area);
+      largest_bitrate = MAX (largest_bitrate, bitrate);
+
+      if (i == current)
+        {
+          current_area = area;
+          current_bitrate = bitrate;
+          current_covers = covers;
+        }
+
+      if (best < 0 ||
+          (covers && (!best_covers || area < best_area)) ||
+          (!covers && !best_covers && area > best_area))
+        {
+          best = i;
+          best_area = area;
+          best_bitrate = bitrate;
+          best_covers = covers;
+          best_spare = w >= width * SELECT_MARGIN &&
+                       h >= height * SELECT_MARGIN;
+        }
+    }
+
+  if (best < 0)
+    return;
+
+  if (best != current &&
+      !(current_covers && best_area < current_area && !best_spare))
+    {
+      set_current_video (self, best);
+      current_area = best_area;
+      current_bitrate = best_bitrate;
+    }
+
+  priv->pixel_savings = largest_area > 0 ?
+                        1.0 - (gdouble) current_area / largest_area : 0;
+  priv->bitrate_savings = largest_bitrate > 0 && current_bitrate > 0 ?
+                          1.0 - (gdouble) current_bitrate / largest_bitrate : 0;
+}
+
+/* Runs on the streaming thread for every decoded frame. Returning
+ * FALSE drops the frame before colorspace conversion and the sink.
+ */
+static gboolean
+frame_cap_probe (GstPad    *pad,
+                 GstBuffer *buffer,
+                 gpointer   data)
+{
+  ClutterGstOverlayActorPrivate *priv = CLUTTER_GST_OVERLAY_ACTOR (data)->priv;
+  GstClockTime interval = priv->frame_interval;
+  GstClockTime ts = GST_BUFFER_TIMESTAMP (buffer);
 
-  if (!result)
+  if (G_UNLIKELY (priv->trace_first_frame))
     {
-      g_warning ("Unable to get progress\n");
-      return -1;
+      gint64 trace_start;
+
+      g_mutex_lock (priv->frame_lock);
+      trace_start = priv->trace_first_frame;
+      priv->trace_first_frame = 0;
+      g_mutex_unlock (priv->frame_lock);
+
+      CLUTTER_GST_OVERLAY_TRACE_END ("first-frame", NULL, data, trace_start);
     }
 
-  if (format != GST_FORMAT_TIME)
+  if (interval == 0 || !GST_CLOCK_TIME_IS_VALID (ts))
+    return TRUE;
+
+  /* Timestamps going backwards mean a seek; start over */
+  if (GST_CLOCK_TIME_IS_VALID (priv->last_frame_ts) &&
+      ts >= priv->last_frame_ts &&
+      ts - priv->last_frame_ts < interval - interval / 8)
     {
-      g_warning ("It is not format of the progress\n");
-      return -1;
+      priv->frames_dropped++;
+      priv->frame_bytes_dropped += GST_BUFFER_SIZE (buffer);
+      return FALSE;
     }
 
-  return (gdouble)progress / get_duration (self);
+  priv->last_frame_ts = ts;
+
+  return TRUE;
 }
 
-static void
-set_subtitle_uri (ClutterGstOverlayActor *self,
-                  const gchar            *uri)
+static gboolean
+emit_video_size_changed (gpointer data)
 {
-  g_object_set (G_OBJECT (self->priv->pipeline), "suburi", uri, NULL);
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+  gint width, height;
+  gfloat w, h;
+
+  g_mutex_lock (self->priv->frame_lock);
+  width = self->priv->video_width;
+  height = self->priv->video_height;
+  g_mutex_unlock (self->priv->frame_lock);
+
+  g_signal_emit (self, signals[VIDEO_SIZE_CHANGED], 0, width, height);
+
+  clutter_actor_get_transformed_size (CLUTTER_ACTOR (self), &w, &h);
+
+  /* Every stream is negotiated by the time the active one is */
+  if (self->priv->auto_video)
+    select_video_stream (self, w, h);
+
+  update_scale_caps (self, w);
+
+  return FALSE;
 }
 
-static gchar *
-get_subtitle_uri (ClutterGstOverlayActor *self)
+/* Streaming thread; the signal is emitted from the main loop */
+static void
+frame_caps_notify (GstPad     *pad,
+                   GParamSpec *pspec,
+                   gpointer    data)
 {
-  gchar *uri = NULL;
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
+  ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstCaps *caps = gst_pad_get_negotiated_caps (pad);
+  GstVideoFormat format;
+  gint width, height, par_n = 1, par_d = 1, fps_n = 0, fps_d = 1;
+  gboolean changed;
 
-  g_object_get (G_OBJECT (self->priv->pipeline), "suburi", &uri, NULL);
+  if (!caps)
+    return;
 
-  return uri;
+  if (!gst_video_format_parse_caps (caps, &format, &width, &height))
+    {
+      gst_caps_unref (caps);
+      return;
+    }
+
+  gst_video_parse_caps_pixel_aspect_ratio (caps, &par_n, &par_d);
+  gst_video_parse_caps_framerate (caps, &fps_n, &fps_d);
+  gst_caps_unref (caps);
+
+  g_mutex_lock (priv->frame_lock);
+
+  changed = width != priv->video_width || height != priv->video_height ||
+            par_n * priv->video_par_d != priv->video_par_n * par_d;
+
+  priv->video_width = width;
+  priv->video_height = height;
+  priv->video_par_n = par_n;
+  priv->video_par_d = par_d;
+  priv->video_fps_n = fps_n;
+  priv->video_fps_d = fps_d;
+
+  g_mutex_unlock (priv->frame_lock);
+
+  if (changed)
+    clutter_threads_add_idle_full (G_PRIORITY_DEFAULT, emit_video_size_changed,
+                                   g_object_ref (self), g_object_unref);
 }
 
+/* The probe sits on the video input-selector source pad, which stays
+ * the same when the current video stream changes.
+ */
 static void
-set_subtitle_font_name (ClutterGstOverlayActor *self,
-                        const gchar            *font_name)
+video_changed_cb (GstElement *pipeline,
+                  gpointer    data)
 {
+  ClutterGstOverlayActor *self = CLUTTER_GST_OVERLAY_ACTOR (data);
   ClutterGstOverlayActorPrivate *priv = self->priv;
+  GstPad *video_pad, *src_pad = NULL;
+  GstElement *selector;
 
-  g_free (priv->font_name);
+  video_pad = get_video_pad (self, MAX (get_current_video (self), 0));
 
-  priv->font_name = g_strdup (font_name);
+  if (!video_pad)
+    return;
 
-  g_object_set (G_OBJECT (priv->pipeline),
-                "subtitle-font-desc", font_name,
-                NULL);
+  selector = gst_pad_get_parent_element (video_pad);
+  gst_object_unref (video_pad);
+
+  if (selector)
+    {
+      src_pad = gst_element_get_static_pad (selector, "src");
+      gst_object_unref (selector);
+    }
+
+  if (!src_pad)
+    return;
+
+  g_mutex_lock (priv->frame_lock);
+
+  if (src_pad != priv->frame_cap_pad)
+    {
+      if (priv->frame_cap_pad)
+        {
+          gst_pad_remove_buffer_probe (priv->frame_cap_pad,
+                                       priv->frame_cap_probe);
+          g_signal_handler_disconnect (priv->frame_cap_pad,
+                                       priv->frame_caps_handler);
+          gst_object_unref (priv->frame_cap_pad);
+        }
+
+      priv->frame_cap_pad = gst_object_ref (src_pad);
+      priv->frame_cap_probe = gst_pad_add_buffer_probe (src_pad,
+                                                        G_CALLBACK (frame_cap_probe),
+                                                        self);
+      priv->frame_caps_handler = g_signal_connect (src_pad, "notify::caps",
+                                                   G_CALLBACK (frame_caps_notify),
+                                                   self);
+      priv->last_frame_ts = GST_CLOCK_TIME_NONE;
+    }
+
+  g_mutex_unlock (priv->frame_lock);
+
+  /* The selector may already be negotiated */
+  frame_caps_notify (src_pad, NULL, self);
+
+  gst_object_unref (src_pad);
 }
 
-static gchar *
-get_subtitle_font_name (ClutterGstOverlayActor *self)
+static void
+set_max_framerate (ClutterGstOverlayActor *self,
+                   gdouble                 framerate)
 {
-  return g_strdup (self->priv->font_name);
+  gfloat w, h;
+
+  self->priv->max_framerate = framerate;
+
+  clutter_actor_get_transformed_size (CLUTTER_ACTOR (self), &w, &h);
+  update_frame_cap (self, w, h);
 }
 
-static gdouble
-get_buffer_fill (ClutterGstOverlayActor *self)
+static void
+set_auto_framerate (ClutterGstOverlayActor *self,
+                    gboolean                auto_framerate)
 {
-  return self->priv->buffer_fill;
+  gfloat w, h;
+
+  self->priv->auto_framerate = auto_framerate;
+
+  clutter_actor_get_transformed_size (CLUTTER_ACTOR (self), &w, &h);
+  update_frame_cap (self, w, h);
 }
 
-static gboolean
-get_can_seek (ClutterGstOverlayActor *self)
+static void
+set_auto_video (ClutterGstOverlayActor *self,
+                gboolean                auto_video)
 {
-  gboolean can_seek = FALSE;
-  GstQuery *seeking = gst_query_new_seeking (GST_FORMAT_TIME);
+  gfloat w, h;
 
-  if (gst_element_query (self->priv->pipeline, seeking))
-    gst_query_parse_seeking (seeking, NULL, &can_seek, NULL, NULL);
+  self->priv->auto_video = auto_video;
 
-  gst_query_unref (seeking);
+  if (!auto_video)
+    {
+      self->priv->pixel_savings = 0;
+      self->priv->bitrate_savings = 0;
+    }
 
-  return can_seek;
+  clutter_actor_get_transformed_size (CLUTTER_ACTOR (self), &w, &h);
+  select_video_stream (self, w, h);
 }
 
-static GstPad*
-get_pad (ClutterGstOverlayActor *self,
-         const gchar            *type_of_pad,
-         gint                    stream)
+static void
+set_decoder_threads (ClutterGstOverlayActor *self,
+                     gint                    threads)
 {
-  GstPad *pad = NULL;
+  g_static_mutex_lock (&actors_lock);
 
-  g_signal_emit_by_name (self->priv->pipeline, type_of_pad, stream, &pad);
+  self->priv->decoder_threads = threads;
+  apply_decoder_threads_locked (self);
 
-  return pad;
+  g_static_mutex_unlock (&actors_lock);
 }
 
-static GstPad*
-get_text_pad (ClutterGstOverlayActor *self,
-              gint                    stream)
+static void
+set_memory_budget (ClutterGstOverlayActor *self,
+                   guint64                 budget)
 {
-  return get_pad (self, "get-text-pad", stream);
-}
+  g_static_mutex_lock (&actors_lock);
 
-static GstPad*
-get_audio_pad (ClutterGstOverlayActor *self,
-               gint                    stream)
-{
-  return get_pad (self, "get-audio-pad", stream);
-}
+  self->priv->memory_budget = budget;
+  apply_memory_budget_locked (self);
 
-static GstPad*
-get_video_pad (ClutterGstOverlayActor *self,
-               gint                    stream)
-{
-  return get_pad (self, "get-video-pad", stream);
+  g_static_mutex_unlock (&actors_lock);
 }
 
 static void
@@ -571,6 +4227,8 @@ clutter_gst_overlay_actor_set_property (GObject      *object,
       break;
 
     case PROP_CURRENT_VIDEO:
+      /* An explicit choice wins over the size-aware one */
+      self->priv->auto_video = FALSE;
       set_current_video (self, g_value_get_int (value));
       break;
 
@@ -578,6 +4236,51 @@ clutter_gst_overlay_actor_set_property (GObject      *object,
       clutter_gst_overlay_actor_set_mute (self, g_value_get_boolean (value));
       break;
 
+    case PROP_RENDER_MODE:
+      set_render_mode (self, g_value_get_enum (value));
+      break;
+
+    case PROP_MAX_FRAMERATE:
+      set_max_framerate (self, g_value_get_double (value));
+      break;
+
+    case PROP_AUTO_FRAMERATE:
+      set_auto_framerate (self, g_value_get_boolean (value));
+      break;
+
+    case PROP_AUTO_VIDEO:
+      set_auto_video (self, g_value_get_boolean (value));
+      break;
+
+    case PROP_DECODER_THREADS:
+      set_decoder_threads (self, g_value_get_int (value));
+      break;
+
+    case PROP_MEMORY_BUDGET:
+      set_memory_budget (self, g_value_get_uint64 (value));
+      break;
+
+    case PROP_LATENCY_PROFILE:
+      set_latency_profile (self, g_value_get_enum (value));
+      break;
+
+    case PROP_FULLSCREEN:
+      clutter_gst_overlay_actor_set_fullscreen (self,
+                                                g_value_get_boolean (value));
+      break;
+
+    case PROP_SHARED_AUDIO:
+      set_shared_audio (self, g_value_get_boolean (value));
+      break;
+
+    case PROP_TIMESHIFT_SIZE:
+      self->priv->timeshift_size = g_value_get_uint64 (value);
+      break;
+
+    case PROP_MAX_RETRIES:
+      self->priv->max_retries = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -658,6 +4361,118 @@ clutter_gst_overlay_actor_get_property (GObject    *object,
       g_value_set_boolean (value, clutter_gst_overlay_actor_get_mute (self));
       break;
 
+    case PROP_RENDER_MODE:
+      g_value_set_enum (value, self->priv->render_mode);
+      break;
+
+    case PROP_FRAMES_UPLOADED:
+      g_value_set_uint64 (value, self->priv->frames_uploaded);
+      break;
+
+    case PROP_FRAMES_SKIPPED:
+      g_value_set_uint64 (value, self->priv->frames_skipped);
+      break;
+
+    case PROP_MAX_FRAMERATE:
+      g_value_set_double (value, self->priv->max_framerate);
+      break;
+
+    case PROP_AUTO_FRAMERATE:
+      g_value_set_boolean (value, self->priv->auto_framerate);
+      break;
+
+    case PROP_AUTO_VIDEO:
+      g_value_set_boolean (value, self->priv->auto_video);
+      break;
+
+    case PROP_PIXEL_SAVINGS:
+      g_value_set_double (value, self->priv->pixel_savings);
+      break;
+
+    case PROP_BITRATE_SAVINGS:
+      g_value_set_double (value, self->priv->bitrate_savings);
+      break;
+
+    case PROP_FRAMES_DROPPED:
+      g_value_set_uint64 (value, self->priv->frames_dropped);
+      break;
+
+    case PROP_FRAME_BYTES_DROPPED:
+      g_value_set_uint64 (value, self->priv->frame_bytes_dropped);
+      break;
+
+    case PROP_DECODER_THREADS:
+      g_value_set_int (value, self->priv->decoder_threads);
+      break;
+
+    case PROP_MEMORY_BUDGET:
+      g_value_set_uint64 (value, self->priv->memory_budget);
+      break;
+
+    case PROP_MEMORY_USED:
+      g_value_set_uint64 (value, get_memory_used (self));
+      break;
+
+    case PROP_LATENCY_PROFILE:
+      g_value_set_enum (value, self->priv->latency_profile);
+      break;
+
+    case PROP_LATENCY:
+      g_value_set_uint64 (value, self->priv->latency);
+      break;
+
+    case PROP_MEASURED_LATENCY:
+      g_value_set_uint64 (value, self->priv->measured_latency);
+      break;
+
+    case PROP_TIMESHIFT_SIZE:
+      g_value_set_uint64 (value, self->priv->timeshift_size);
+      break;
+
+    case PROP_MAX_RETRIES:
+      g_value_set_uint (value, self->priv->max_retries);
+      break;
+
+    case PROP_RECOVERY_COUNT:
+      g_value_set_uint (value, self->priv->recovery_count);
+      break;
+
+    case PROP_RETRY_COUNT:
+      g_value_set_uint (value, self->priv->retry_count);
+      break;
+
+    case PROP_LAST_RECOVERY_TIME:
+      g_value_set_uint64 (value, self->priv->last_recovery_time);
+      break;
+
+    case PROP_LAST_SWITCH_LATENCY:
+      g_value_set_uint64 (value, self->priv->last_switch_latency);
+      break;
+
+    case PROP_SHARED_AUDIO:
+      g_value_set_boolean (value, self->priv->audio_channel != NULL);
+      break;
+
+    case PROP_CLIPPED_PIXELS:
+      g_value_set_uint (value, self->priv->clipped_pixels);
+      break;
+
+    case PROP_X_ERRORS:
+      g_value_set_uint (value, self->priv->x_errors);
+      break;
+
+    case PROP_FULLSCREEN:
+      g_value_set_boolean (value, self->priv->fullscreen);
+      break;
+
+    case PROP_CONVERSION_PATH:
+      g_value_set_boolean (value, self->priv->conversion_path);
+      break;
+
+    case PROP_CONVERSION_TIME:
+      g_value_set_uint64 (value, self->priv->conversion_time);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -670,6 +4485,7 @@ bus_call (GstBus     *bus,
           gpointer    data)
 {
   ClutterGstOverlayActor *actor = CLUTTER_GST_OVERLAY_ACTOR (data);
+  gint64 trace_start = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
 
   switch (GST_MESSAGE_TYPE (msg)) {
 
@@ -689,13 +4505,58 @@ bus_call (GstBus     *bus,
     gst_message_parse_error (msg, &error, &debug);
     g_free (debug);
 
-    gst_element_set_state (actor->priv->pipeline, GST_STATE_NULL);
-    g_signal_emit_by_name (actor, "error", error);
+    if (GST_MESSAGE_SRC (msg) == GST_OBJECT (actor->priv->window_sink) &&
+        use_fallback_window_sink (actor))
+      {
+        g_error_free (error);
+        break;
+      }
+
+    if (!start_recovery (actor))
+      {
+        cancel_recovery (actor);
+        gst_element_set_state (actor->priv->pipeline, GST_STATE_NULL);
+        g_signal_emit_by_name (actor, "error", error);
+      }
 
     g_error_free (error);
     break;
   }
 
+  case GST_MESSAGE_ASYNC_DONE: {
+    /* Seekability is only known once prerolled */
+    actor->priv->cached_can_seek = -1;
+    recovery_async_done (actor);
+
+    CLUTTER_GST_OVERLAY_TRACE_END ("preroll", NULL, actor,
+                                   actor->priv->trace_preroll);
+    CLUTTER_GST_OVERLAY_TRACE_END ("seek", NULL, actor,
+                                   actor->priv->trace_seek);
+    actor->priv->trace_preroll = 0;
+    actor->priv->trace_seek = 0;
+    break;
+  }
+
+  case GST_MESSAGE_DURATION: {
+    actor->priv->cached_duration = GST_CLOCK_TIME_NONE;
+    break;
+  }
+
+  case GST_MESSAGE_TAG: {
+    GstTagList *tags, *merged;
+
+    gst_message_parse_tag (msg, &tags);
+    merged = gst_tag_list_merge (actor->priv->tags, tags,
+                                 GST_TAG_MERGE_REPLACE);
+    gst_tag_list_free (tags);
+
+    if (actor->priv->tags)
+      gst_tag_list_free (actor->priv->tags);
+
+    actor->priv->tags = merged;
+    break;
+  }
+
   case GST_MESSAGE_BUFFERING: {
     gint percent;
     ClutterGstOverlayActorPrivate *priv = actor->priv;
@@ -713,17 +4574,25 @@ bus_call (GstBus     *bus,
 
   case GST_MESSAGE_ELEMENT : {
     if (gst_structure_has_name (msg->structure, "prepare-xwindow-id"))
-      gst_x_overlay_set_xwindow_id (GST_X_OVERLAY (actor->priv->video_sink),
+      gst_x_overlay_set_xwindow_id (GST_X_OVERLAY (actor->priv->window_sink),
+                                    actor->priv->shared_window ?
+                                    actor->priv->shared_window->window :
                                     actor->priv->window);
     break;
   }
 
+  case GST_MESSAGE_LATENCY: {
+    gst_bin_recalculate_latency (GST_BIN (actor->priv->pipeline));
+    update_latency (actor);
+    break;
+  }
+
   case GST_MESSAGE_STATE_CHANGED: {
     GstState old_state, new_state;
     GstElement *src = GST_ELEMENT (GST_MESSAGE_SRC (msg));
 
     if (actor->priv->pipeline != src)
-      return;
+      break;
 
     gst_message_parse_state_changed (msg, &old_state, &new_state, NULL);
 
@@ -747,6 +4616,9 @@ bus_call (GstBus     *bus,
     break;
   }
 
+  CLUTTER_GST_OVERLAY_TRACE_END ("bus", GST_MESSAGE_TYPE_NAME (msg),
+                                 actor, trace_start);
+
   return TRUE;
 }
 
@@ -767,6 +4639,11 @@ clutter_gst_overlay_actor_init (ClutterGstOverlayActor *self)
   Display *display = GINT_TO_POINTER (clutter_x11_get_default_display ());
   Window rootwindow = clutter_x11_get_root_window ();
   int screen = clutter_x11_get_default_screen ();
+  static gint has_shape = -1;
+  int shape_event_base, shape_error_base;
+  GstPlayFlags flags;
+  gint64 started = g_get_monotonic_time ();
+  gulong first;
   Window window;
 
   self->priv = priv = CLUTTER_GST_OVERLAY_ACTOR_GET_PRIVATE (self);
@@ -777,19 +4654,107 @@ clutter_gst_overlay_actor_init (ClutterGstOverlayActor *self)
   XSetWindowAttributes attributes;
   attributes.override_redirect = True;
   attributes.background_pixel = BlackPixel(display, screen);
+
+  first = x_begin (display);
   priv->window = window = XCreateWindow (display, rootwindow,
                                          0, 0, 1, 1, 0, 0, 0, 0,
                                          CWBackPixel | CWOverrideRedirect,
                                          &attributes);
 
-  XSync (display, FALSE);
+  x_end (display, first, self);
+
+  /* The only round trip, once per process */
+  if (has_shape < 0)
+    {
+      has_shape = XShapeQueryExtension (display, &shape_event_base,
+                                        &shape_error_base);
+    }
+
+  priv->has_shape = has_shape;
 
   priv->pipeline   = pipeline   = gst_element_factory_make ("playbin2",
                                                             "pipeline");
-  priv->video_sink = video_sink = gst_element_factory_make ("ximagesink",
-                                                            "window");
+  video_sink = make_native_window_sink ();
+  priv->window_scales = video_sink == NULL;
+
+  if (!video_sink)
+    video_sink = gst_element_factory_make ("ximagesink", "window");
+
+  priv->window_sink = gst_object_ref_sink (video_sink);
+  priv->window_output = make_output_bin (self, video_sink, "window-output");
+  priv->video_sink = priv->window_output;
+  priv->texture_sink = NULL;
+  priv->texture_output = NULL;
+  priv->scale_width = -1;
+  priv->convert_started = 0;
+  priv->conversion_path = FALSE;
+  priv->conversion_time = 0;
+  priv->render_mode = CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW;
+  priv->frame_lock = g_mutex_new ();
+  priv->pending_frame = NULL;
+  priv->frame_textures[0] = COGL_INVALID_HANDLE;
+  priv->frame_textures[1] = COGL_INVALID_HANDLE;
+  priv->front_texture = 0;
+  priv->frame_material = cogl_material_new ();
+  priv->max_framerate = 0;
+  priv->auto_framerate = FALSE;
+  priv->auto_video = FALSE;
+  priv->connection_speed = 0;
+  priv->pixel_savings = 0;
+  priv->bitrate_savings = 0;
+  priv->frame_interval = 0;
+  priv->last_frame_ts = GST_CLOCK_TIME_NONE;
+  priv->frame_cap_pad = NULL;
+  priv->decoder_threads = 0;
+  priv->screen_area = 0;
+  priv->decoders = NULL;
+  priv->memory_budget = 0;
+  priv->queues = NULL;
+  priv->latency_profile = CLUTTER_GST_OVERLAY_LATENCY_PROFILE_DEFAULT;
+  priv->live_saved_flags = 0;
+  priv->latency = 0;
+  priv->measured_latency = GST_CLOCK_TIME_NONE;
   priv->font_name  = NULL;
   priv->buffer_fill = 1.0;
+  priv->snapshot_buffer = NULL;
+  priv->snapshot_texture = COGL_INVALID_HANDLE;
+  priv->timeshift_size = 0;
+  priv->timeshift = NULL;
+  priv->timeshift_lock = g_mutex_new ();
+  priv->timeshift_seek_offset = TIMESHIFT_NO_SEEK;
+  priv->timeshift_watch = 0;
+  priv->max_retries = 0;
+  priv->retry_source = 0;
+  priv->recovery_phase = RECOVERY_IDLE;
+  priv->last_recovery_time = 0;
+  priv->cached_duration = GST_CLOCK_TIME_NONE;
+  priv->cached_can_seek = -1;
+  priv->tags = NULL;
+  priv->text_overlay = NULL;
+  priv->subtitles_visible = TRUE;
+  priv->switch_pad = NULL;
+  priv->last_switch_latency = 0;
+  priv->subtitles = NULL;
+  priv->subtitle_bin = NULL;
+  priv->subtitle_overlay = NULL;
+  priv->cue_start = GST_CLOCK_TIME_NONE;
+  priv->audio_channel = NULL;
+  priv->shaped = FALSE;
+  priv->fully_clipped = FALSE;
+  priv->clipped_pixels = 0;
+  priv->shared_window = NULL;
+  priv->fullscreen = FALSE;
+  priv->x_dirty = FALSE;
+  priv->x_pending_parent = None;
+  priv->x_errors = 0;
+  priv->trace_preroll = 0;
+  priv->trace_first_frame = 0;
+  priv->trace_seek = 0;
+  gst_segment_init (&priv->subtitle_segment, GST_FORMAT_TIME);
+
+  /* Keeps the frame on screen reachable for snapshots */
+  g_object_set (G_OBJECT (video_sink), "enable-last-buffer", TRUE, NULL);
+  add_latency_probe (self, video_sink);
 
   bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
   gst_bus_add_watch (bus, bus_call, self);
@@ -803,10 +4768,40 @@ clutter_gst_overlay_actor_init (ClutterGstOverlayActor *self)
                     G_CALLBACK (clutter_gst_overlay_actor_allocate), NULL);
   g_signal_connect (self, "parent-set",
                     G_CALLBACK (clutter_gst_overlay_actor_parent_set), NULL);
-
-  g_object_set (G_OBJECT (pipeline), "video-sink", video_sink, NULL);
+  g_signal_connect_after (self, "paint",
+                          G_CALLBACK (clutter_gst_overlay_actor_paint_frame), NULL);
+
+  g_signal_connect (pipeline, "video-changed",
+                    G_CALLBACK (video_changed_cb), self);
+  g_signal_connect (pipeline, "element-added",
+                    G_CALLBACK (pipeline_element_added), self);
+  g_signal_connect (pipeline, "notify::source",
+                    G_CALLBACK (source_notify_cb), self);
+
+  g_static_mutex_lock (&actors_lock);
+  actors = g_list_prepend (actors, self);
+  g_static_mutex_unlock (&actors_lock);
+
+  if (total_memory_budget > 0)
+    rebalance_memory_budget ();
+
+  make_subtitle_bin (self);
+
+  g_object_get (G_OBJECT (pipeline), "flags", &flags, NULL);
+  g_object_set (G_OBJECT (pipeline),
+                "flags", flags | GST_PLAY_FLAG_NATIVE_VIDEO,
+                "video-sink", priv->subtitle_bin ? priv->subtitle_bin :
+                                                   priv->video_sink,
+                NULL);
 
   clutter_gst_overlay_actor_allocate (CLUTTER_ACTOR (self), NULL, 0, NULL);
+
+  g_static_mutex_lock (&prewarm_lock);
+
+  if (!GST_CLOCK_TIME_IS_VALID (first_actor_latency))
+    first_actor_latency = (g_get_monotonic_time () - started) * GST_USECOND;
+
+  g_static_mutex_unlock (&prewarm_lock);
 }
 
 static void
@@ -907,25 +4902,369 @@ clutter_gst_overlay_actor_class_init (ClutterGstOverlayActorClass *klass)
                             -1,
                             G_PARAM_READWRITE);
   g_object_class_install_property (gobject_class,
-                                   PROP_CURRENT_AUDIO, pspec);
+                                   PROP_CURRENT_AUDIO, pspec);
+
+  pspec = g_param_spec_int ("current-video",
+                            "Current video",
+                            "Number of current video stream",
+                            -1,
+                            G_MAXINT,
+                            -1,
+                            G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CURRENT_VIDEO, pspec);
+
+  pspec = g_param_spec_boolean ("mute",
+                                "Muted",
+                                "Is audio channel muted",
+                                FALSE,
+                                G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_MUTE, pspec);
+
+  pspec = g_param_spec_enum ("render-mode",
+                             "Render mode",
+                             "How decoded frames reach the screen",
+                             CLUTTER_TYPE_GST_OVERLAY_RENDER_MODE,
+                             CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW,
+                             G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_RENDER_MODE, pspec);
+
+  pspec = g_param_spec_uint64 ("frames-uploaded",
+                               "Frames uploaded",
+                               "Count of frames uploaded in texture mode",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAMES_UPLOADED, pspec);
+
+  pspec = g_param_spec_uint64 ("frames-skipped",
+                               "Frames skipped",
+                               "Count of frames dropped in texture mode "
+                               "because the stage painted slower",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAMES_SKIPPED, pspec);
+
+  pspec = g_param_spec_double ("max-framerate",
+                               "Max framerate",
+                               "Upper bound on displayed frames per second, "
+                               "0 for the source rate",
+                               0,
+                               G_MAXDOUBLE,
+                               0,
+                               G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_FRAMERATE, pspec);
+
+  pspec = g_param_spec_boolean ("auto-framerate",
+                                "Auto framerate",
+                                "Lower the frame rate cap for small actors",
+                                FALSE,
+                                G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_AUTO_FRAMERATE, pspec);
+
+  pspec = g_param_spec_uint64 ("frames-dropped",
+                               "Frames dropped",
+                               "Count of frames dropped by the frame rate cap",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAMES_DROPPED, pspec);
+
+  pspec = g_param_spec_uint64 ("frame-bytes-dropped",
+                               "Frame bytes dropped",
+                               "Raw video bytes kept away from conversion "
+                               "and the sink by the frame rate cap",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAME_BYTES_DROPPED, pspec);
 
-  pspec = g_param_spec_int ("current-video",
-                            "Current video",
-                            "Number of current video stream",
-                            -1,
+  pspec = g_param_spec_int ("decoder-threads",
+                            "Decoder threads",
+                            "Threads per video decoder, 0 for the "
+                            "process-wide default",
+                            0,
                             G_MAXINT,
-                            -1,
+                            0,
                             G_PARAM_READWRITE);
   g_object_class_install_property (gobject_class,
-                                   PROP_CURRENT_VIDEO, pspec);
+                                   PROP_DECODER_THREADS, pspec);
+
+  pspec = g_param_spec_uint64 ("memory-budget",
+                               "Memory budget",
+                               "Bytes the pipeline's queues may hold, "
+                               "0 for no limit",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_MEMORY_BUDGET, pspec);
+
+  pspec = g_param_spec_uint64 ("memory-used",
+                               "Memory used",
+                               "Bytes currently held in the pipeline's queues",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_MEMORY_USED, pspec);
 
-  pspec = g_param_spec_boolean ("mute",
-                                "Muted",
-                                "Is audio channel muted",
+  pspec = g_param_spec_boolean ("auto-video",
+                                "Auto video",
+                                "Pick the smallest video stream and "
+                                "variant covering the actor on screen",
                                 FALSE,
                                 G_PARAM_READWRITE);
   g_object_class_install_property (gobject_class,
-                                   PROP_MUTE, pspec);
+                                   PROP_AUTO_VIDEO, pspec);
+
+  pspec = g_param_spec_double ("pixel-savings",
+                               "Pixel savings",
+                               "Fraction of the largest stream's pixels "
+                               "not shown by auto-video; every stream is "
+                               "still decoded",
+                               0,
+                               1,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_PIXEL_SAVINGS, pspec);
+
+  pspec = g_param_spec_double ("bitrate-savings",
+                               "Bitrate savings",
+                               "Fraction of the largest stream's tagged "
+                               "bitrate saved by auto-video",
+                               0,
+                               1,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_BITRATE_SAVINGS, pspec);
+
+  pspec = g_param_spec_enum ("latency-profile",
+                             "Latency profile",
+                             "Pipeline tuning for files or live sources",
+                             CLUTTER_TYPE_GST_OVERLAY_LATENCY_PROFILE,
+                             CLUTTER_GST_OVERLAY_LATENCY_PROFILE_DEFAULT,
+                             G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_LATENCY_PROFILE, pspec);
+
+  pspec = g_param_spec_uint64 ("latency",
+                               "Latency",
+                               "Latency configured in the pipeline, in ns",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_LATENCY, pspec);
+
+  pspec = g_param_spec_uint64 ("measured-latency",
+                               "Measured latency",
+                               "Average time from frame timestamp to arrival "
+                               "at the sink in the live profile, in ns",
+                               0,
+                               G_MAXUINT64,
+                               GST_CLOCK_TIME_NONE,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_MEASURED_LATENCY, pspec);
+
+  pspec = g_param_spec_uint64 ("timeshift-size",
+                               "Timeshift size",
+                               "Bytes of the stream kept on disk for pause "
+                               "and rewind, 0 disables; used by the next URI",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_TIMESHIFT_SIZE, pspec);
+
+  pspec = g_param_spec_uint ("max-retries",
+                             "Max retries",
+                             "Attempts to restart from the last position "
+                             "before an error is emitted, 0 disables",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_RETRIES, pspec);
+
+  pspec = g_param_spec_uint ("recovery-count",
+                             "Recovery count",
+                             "Errors recovered from without emitting error",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_RECOVERY_COUNT, pspec);
+
+  pspec = g_param_spec_uint ("retry-count",
+                             "Retry count",
+                             "Restart attempts made, successful or not",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_RETRY_COUNT, pspec);
+
+  pspec = g_param_spec_uint64 ("last-recovery-time",
+                               "Last recovery time",
+                               "Nanoseconds from the error to resumed "
+                               "playback in the last recovery",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_LAST_RECOVERY_TIME, pspec);
+
+  pspec = g_param_spec_uint64 ("last-switch-latency",
+                               "Last switch latency",
+                               "Nanoseconds from the last audio or text "
+                               "switch to the first buffer of the new stream",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_LAST_SWITCH_LATENCY, pspec);
+
+  pspec = g_param_spec_boolean ("shared-audio",
+                                "Shared audio",
+                                "Play audio through the process-wide mixer",
+                                FALSE,
+                                G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_SHARED_AUDIO, pspec);
+
+  pspec = g_param_spec_uint ("clipped-pixels",
+                             "Clipped pixels",
+                             "Pixels of the window the X server no longer "
+                             "draws because they are clipped away",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CLIPPED_PIXELS, pspec);
+
+  pspec = g_param_spec_uint ("x-errors",
+                             "X errors",
+                             "X errors caused by requests for this actor",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_X_ERRORS, pspec);
+
+  pspec = g_param_spec_boolean ("fullscreen",
+                                "Fullscreen",
+                                "Pin the video window to the stage, "
+                                "ignoring the actor's geometry",
+                                FALSE,
+                                G_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_FULLSCREEN, pspec);
+
+  pspec = g_param_spec_boolean ("conversion-path",
+                                "Conversion path",
+                                "Whether frames are colorspace converted "
+                                "before the sink",
+                                FALSE,
+                                G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CONVERSION_PATH, pspec);
+
+  pspec = g_param_spec_uint64 ("conversion-time",
+                               "Conversion time",
+                               "Average per-frame scaling and conversion "
+                               "time in nanoseconds",
+                               0,
+                               G_MAXUINT64,
+                               0,
+                               G_PARAM_READABLE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CONVERSION_TIME, pspec);
+
+  /* Emitted on the main loop when the negotiated size or pixel
+   * aspect ratio changes.
+   */
+  signals[VIDEO_SIZE_CHANGED] =
+    g_signal_new ("video-size-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  g_cclosure_marshal_generic,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_INT,
+                  G_TYPE_INT);
+}
+
+GType
+clutter_gst_overlay_render_mode_get_type (void)
+{
+  static GType type = 0;
+
+  if (G_UNLIKELY (type == 0))
+    {
+      static const GEnumValue values[] = {
+        { CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW,
+          "CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW", "window" },
+        { CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE,
+          "CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE", "texture" },
+        { CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW,
+          "CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW", "shared-window" },
+        { 0, NULL, NULL }
+      };
+
+      type = g_enum_register_static ("ClutterGstOverlayRenderMode", values);
+    }
+
+  return type;
+}
+
+GType
+clutter_gst_overlay_latency_profile_get_type (void)
+{
+  static GType type = 0;
+
+  if (G_UNLIKELY (type == 0))
+    {
+      static const GEnumValue values[] = {
+        { CLUTTER_GST_OVERLAY_LATENCY_PROFILE_DEFAULT,
+          "CLUTTER_GST_OVERLAY_LATENCY_PROFILE_DEFAULT", "default" },
+        { CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE,
+          "CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE", "live" },
+        { 0, NULL, NULL }
+      };
+
+      type = g_enum_register_static ("ClutterGstOverlayLatencyProfile", values);
+    }
+
+  return type;
 }
 
 ClutterActor *
@@ -963,10 +5302,13 @@ clutter_gst_overlay_actor_stop (ClutterGstOverlayActor *self)
   g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self));
 
   GstStateChangeReturn state_change;
+  gint64 trace_start = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
   set_playing (self, FALSE);
   state_change = gst_element_set_state (self->priv->pipeline,
                                         GST_STATE_READY);
 
+  CLUTTER_GST_OVERLAY_TRACE_END ("stop", NULL, self, trace_start);
+
   g_return_if_fail (state_change != GST_STATE_CHANGE_FAILURE);
 }
 
@@ -976,6 +5318,14 @@ clutter_gst_overlay_actor_set_mute (ClutterGstOverlayActor *self,
 {
   g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self));
 
+  if (self->priv->audio_channel)
+    {
+      clutter_gst_overlay_audio_channel_set_mute (self->priv->audio_channel,
+                                                  mute);
+      update_audio_flag (self);
+      return;
+    }
+
   g_object_set (G_OBJECT (self->priv->pipeline), "mute", mute, NULL);
 }
 
@@ -986,27 +5336,49 @@ clutter_gst_overlay_actor_get_mute (ClutterGstOverlayActor *self)
 
   g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), FALSE);
 
+  if (self->priv->audio_channel)
+    return clutter_gst_overlay_audio_channel_get_mute (self->priv->audio_channel);
+
   g_object_get (G_OBJECT (self->priv->pipeline), "mute", &is_muted, NULL);
 
   return is_muted;
 }
 
+/* Once the text overlay exists, hiding subtitles only silences it;
+ * the text stream keeps flowing so showing them again is instant.
+ */
 void
 clutter_gst_overlay_actor_set_subtitle_flag (ClutterGstOverlayActor *self,
                                              gboolean                flag)
 {
+  ClutterGstOverlayActorPrivate *priv;
   GstPlayFlags flags;
 
   g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self));
 
-  g_object_get (G_OBJECT (self->priv->pipeline), "flags", &flags, NULL);
+  priv = self->priv;
+
+  g_mutex_lock (priv->frame_lock);
+
+  priv->subtitles_visible = flag;
+
+  if (priv->text_overlay)
+    {
+      g_object_set (G_OBJECT (priv->text_overlay), "silent", !flag, NULL);
+      g_mutex_unlock (priv->frame_lock);
+      return;
+    }
+
+  g_mutex_unlock (priv->frame_lock);
+
+  g_object_get (G_OBJECT (priv->pipeline), "flags", &flags, NULL);
 
   if (flag)
     flags |= GST_PLAY_FLAG_TEXT;
   else
     flags &= ~GST_PLAY_FLAG_TEXT;
 
-  g_object_set (G_OBJECT (self->priv->pipeline), "flags", flags, NULL);
+  g_object_set (G_OBJECT (priv->pipeline), "flags", flags, NULL);
 }
 
 gboolean
@@ -1016,29 +5388,180 @@ clutter_gst_overlay_actor_get_subtitle_flag (ClutterGstOverlayActor *self)
 
   g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), FALSE);
 
+  if (self->priv->text_overlay)
+    return self->priv->subtitles_visible;
+
   g_object_get (G_OBJECT (self->priv->pipeline), "flags", &flags, NULL);
 
   return !(!(flags & GST_PLAY_FLAG_TEXT));
 }
 
+/* Cached from the negotiated caps; FALSE until the first video
+ * caps are known.
+ */
 gboolean
 clutter_gst_overlay_actor_get_video_size (ClutterGstOverlayActor *self,
                                           gint                   *width,
                                           gint                   *height)
 {
-  gint video_stream = get_current_video (self);
-  GstPad *video_pad = get_video_pad (self, video_stream);
+  return clutter_gst_overlay_actor_get_video_format (self, width, height,
+                                                     NULL, NULL, NULL, NULL);
+}
+
+/* Any out argument may be NULL. A variable framerate is 0/1. */
+gboolean
+clutter_gst_overlay_actor_get_video_format (ClutterGstOverlayActor *self,
+                                            gint                   *width,
+                                            gint                   *height,
+                                            gint                   *par_n,
+                                            gint                   *par_d,
+                                            gint                   *fps_n,
+                                            gint                   *fps_d)
+{
+  ClutterGstOverlayActorPrivate *priv;
   gboolean result;
 
-  g_return_val_if_fail (video_pad != NULL, FALSE);
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), FALSE);
 
-  result = gst_video_get_size (video_pad, width, height);
+  priv = self->priv;
 
-  gst_object_unref (video_pad);
+  g_mutex_lock (priv->frame_lock);
+
+  result = priv->video_width > 0;
+
+  if (result)
+    {
+      if (width)
+        *width = priv->video_width;
+      if (height)
+        *height = priv->video_height;
+      if (par_n)
+        *par_n = priv->video_par_n;
+      if (par_d)
+        *par_d = priv->video_par_d;
+      if (fps_n)
+        *fps_n = priv->video_fps_n;
+      if (fps_d)
+        *fps_d = priv->video_fps_d;
+    }
+
+  g_mutex_unlock (priv->frame_lock);
 
   return result;
 }
 
+/* Returns the actor's playbin2, owned by the actor */
+GstElement *
+clutter_gst_overlay_actor_get_pipeline (ClutterGstOverlayActor *self)
+{
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), NULL);
+
+  return self->priv->pipeline;
+}
+
+/* Covers the stage with the video window without relayouting anything:
+ * ancestors are no longer tracked, and the next flush moves the window
+ * to the stage bounds. Leaving puts it back from the actor's current
+ * geometry in the same frame. TEXTURE actors paint where they are.
+ */
+void
+clutter_gst_overlay_actor_set_fullscreen (ClutterGstOverlayActor *self,
+                                          gboolean                fullscreen)
+{
+  gint64 trace_start;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self));
+
+  if (self->priv->fullscreen == fullscreen)
+    return;
+
+  trace_start = CLUTTER_GST_OVERLAY_TRACE_BEGIN ();
+
+  self->priv->fullscreen = fullscreen;
+
+  track_ancestors (self, !fullscreen);
+  clutter_gst_overlay_actor_allocate (CLUTTER_ACTOR (self), NULL, 0, NULL);
+
+  CLUTTER_GST_OVERLAY_TRACE_END ("fullscreen", fullscreen ? "enter" : "leave",
+                                 self, trace_start);
+
+  g_object_notify (G_OBJECT (self), "fullscreen");
+}
+
+gboolean
+clutter_gst_overlay_actor_get_fullscreen (ClutterGstOverlayActor *self)
+{
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), FALSE);
+
+  return self->priv->fullscreen;
+}
+
+/* Reads everything in one pass: a single g_object_get for the stream
+ * properties, one position query, and cached duration, seekability
+ * and tags. Free the result with clutter_gst_overlay_media_info_clear ().
+ */
+void
+clutter_gst_overlay_actor_get_media_info (ClutterGstOverlayActor     *self,
+                                          ClutterGstOverlayMediaInfo *info)
+{
+  ClutterGstOverlayActorPrivate *priv;
+  GstFormat format = GST_FORMAT_TIME;
+  gint64 value;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self));
+  g_return_if_fail (info != NULL);
+
+  priv = self->priv;
+
+  g_object_get (G_OBJECT (priv->pipeline),
+                "n-video", &info->n_video,
+                "n-audio", &info->n_audio,
+                "n-text", &info->n_text,
+                "current-video", &info->current_video,
+                "current-audio", &info->current_audio,
+                "current-text", &info->current_text,
+                NULL);
+
+  if (!clutter_gst_overlay_actor_get_video_size (self, &info->width,
+                                                 &info->height))
+    info->width = info->height = -1;
+
+  if (priv->timeshift)
+    priv->cached_duration = (GstClockTime) get_duration (self);
+  else if (!GST_CLOCK_TIME_IS_VALID (priv->cached_duration) &&
+           gst_element_query_duration (priv->pipeline, &format, &value) &&
+           format == GST_FORMAT_TIME && value >= 0)
+    priv->cached_duration = value;
+
+  info->duration = priv->cached_duration;
+
+  format = GST_FORMAT_TIME;
+  info->position = GST_CLOCK_TIME_NONE;
+
+  if (priv->timeshift)
+    info->position = get_timeshift_progress (self) * info->duration;
+  else if (gst_element_query_position (priv->pipeline, &format, &value) &&
+           format == GST_FORMAT_TIME && value >= 0)
+    info->position = value;
+
+  if (priv->cached_can_seek < 0)
+    priv->cached_can_seek = priv->timeshift ? TRUE : get_can_seek (self);
+
+  info->can_seek = priv->cached_can_seek;
+  info->tags = priv->tags ? gst_tag_list_copy (priv->tags) : NULL;
+}
+
+void
+clutter_gst_overlay_media_info_clear (ClutterGstOverlayMediaInfo *info)
+{
+  g_return_if_fail (info != NULL);
+
+  if (info->tags)
+    gst_tag_list_free (info->tags);
+
+  info->tags = NULL;
+}
+
 ClutterGstOverlayStates
 clutter_gst_overlay_actor_get_states (ClutterGstOverlayActor *self)
 {
@@ -1047,3 +5570,279 @@ clutter_gst_overlay_actor_get_states (ClutterGstOverlayActor *self)
 
   return self->priv->states;
 }
+
+/* Returns the frame currently shown by the sink, without copying.
+ * The buffer carries its caps; unref it when done.
+ */
+GstBuffer *
+clutter_gst_overlay_actor_snapshot_buffer (ClutterGstOverlayActor *self)
+{
+  GstBuffer *buffer = NULL;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), NULL);
+
+  g_object_get (G_OBJECT (self->priv->render_mode == CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE ?
+                         self->priv->texture_sink : self->priv->window_sink),
+                "last-buffer", &buffer, NULL);
+
+  return buffer;
+}
+
+/* Returns a new ClutterTexture holding the frame currently shown.
+ * The upload is kept while the sink shows the same buffer, so
+ * repeated calls on a paused actor only create the wrapper actor.
+ */
+ClutterActor *
+clutter_gst_overlay_actor_snapshot (ClutterGstOverlayActor *self)
+{
+  ClutterGstOverlayActorPrivate *priv;
+  ClutterActor *texture;
+  GstBuffer *buffer;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (self), NULL);
+
+  priv = self->priv;
+  buffer = clutter_gst_overlay_actor_snapshot_buffer (self);
+
+  if (!buffer)
+    return NULL;
+
+  /* Holding a reference keeps the sink from recycling the buffer,
+   * so the same pointer means the same frame.
+   */
+  if (buffer != priv->snapshot_buffer)
+    {
+      if (priv->snapshot_buffer)
+        gst_buffer_unref (priv->snapshot_buffer);
+
+      if (priv->snapshot_texture != COGL_INVALID_HANDLE)
+        cogl_handle_unref (priv->snapshot_texture);
+
+      priv->snapshot_buffer = gst_buffer_ref (buffer);
+      priv->snapshot_texture = texture_from_buffer (buffer);
+    }
+
+  gst_buffer_unref (buffer);
+
+  if (priv->snapshot_texture == COGL_INVALID_HANDLE)
+    return NULL;
+
+  texture = clutter_texture_new ();
+  clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (texture),
+                                    priv->snapshot_texture);
+
+  return texture;
+}
+
+/* X requests made by all actors in the last flushed frame. None of
+ * them wait for the server.
+ */
+void
+clutter_gst_overlay_get_x_stats (guint *requests)
+{
+  if (requests)
+    *requests = frame_x_requests;
+}
+
+/* Used by actors whose decoder-threads is 0; 0 lets decoders decide */
+void
+clutter_gst_overlay_set_default_decoder_threads (gint threads)
+{
+  g_return_if_fail (threads >= 0);
+
+  g_static_mutex_lock (&actors_lock);
+  default_decoder_threads = threads;
+  g_static_mutex_unlock (&actors_lock);
+
+  rebalance_decoder_threads ();
+}
+
+gint
+clutter_gst_overlay_get_default_decoder_threads (void)
+{
+  return default_decoder_threads;
+}
+
+/* Total decoder threads shared by all actors in proportion to their
+ * on-screen area, each getting at least one. 0 disables the budget.
+ */
+void
+clutter_gst_overlay_set_decode_budget (gint threads)
+{
+  g_return_if_fail (threads >= 0);
+
+  g_static_mutex_lock (&actors_lock);
+  decode_budget = threads;
+  g_static_mutex_unlock (&actors_lock);
+
+  rebalance_decoder_threads ();
+}
+
+gint
+clutter_gst_overlay_get_decode_budget (void)
+{
+  return decode_budget;
+}
+
+/* Total bytes split evenly between all actors' queues on top of each
+ * actor's own memory-budget. 0 disables it.
+ */
+void
+clutter_gst_overlay_set_memory_budget (guint64 bytes)
+{
+  g_static_mutex_lock (&actors_lock);
+  total_memory_budget = bytes;
+  g_static_mutex_unlock (&actors_lock);
+
+  rebalance_memory_budget ();
+}
+
+guint64
+clutter_gst_overlay_get_memory_budget (void)
+{
+  return total_memory_budget;
+}
+
+/* Factories every actor or its first stream needs */
+static const gchar *prewarm_factories[] = {
+  "playbin2", "xvimagesink", "ximagesink", "appsink", "appsrc",
+  "uridecodebin", "decodebin2", "typefind", "queue2", "multiqueue",
+  "input-selector", "textoverlay", "ffmpegcolorspace", "videoscale",
+  "volume", "audioconvert", "audioresample", "autoaudiosink", NULL
+};
+
+static void
+load_feature (GstPluginFeature *feature)
+{
+  GstPluginFeature *loaded = gst_plugin_feature_load (feature);
+
+  if (loaded)
+    gst_object_unref (loaded);
+}
+
+/* Builds playbin2 with fake sinks and prerolls @uri, which loads the
+ * demuxer and decoder plugins it needs.
+ */
+static void
+prewarm_pipeline (const gchar *uri)
+{
+  GstElement *pipeline = gst_element_factory_make ("playbin2", NULL);
+  GstMessage *msg;
+  GstBus *bus;
+
+  if (!pipeline)
+    return;
+
+  g_object_set (G_OBJECT (pipeline),
+                "uri", uri,
+                "video-sink", gst_element_factory_make ("fakesink", NULL),
+                "audio-sink", gst_element_factory_make ("fakesink", NULL),
+                NULL);
+
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+                                    GST_MESSAGE_ASYNC_DONE | GST_MESSAGE_ERROR);
+
+  if (msg)
+    gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+}
+
+static gpointer
+prewarm_thread_run (gpointer data)
+{
+  gchar *uri = data;
+  gint64 started = g_get_monotonic_time ();
+  GList *decoders, *l;
+  gint i;
+
+  for (i = 0; prewarm_factories[i]; i++)
+    {
+      GstElementFactory *factory = gst_element_factory_find (prewarm_factories[i]);
+
+      if (factory)
+        {
+          load_feature (GST_PLUGIN_FEATURE (factory));
+          gst_object_unref (factory);
+        }
+    }
+
+  probe_native_window_sink ();
+
+  if (uri)
+    prewarm_pipeline (uri);
+  else
+    {
+      /* Without a sample stream, load what autoplugging would try first */
+      decoders = gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_DECODER |
+                                                        GST_ELEMENT_FACTORY_TYPE_DEMUXER,
+                                                        GST_RANK_PRIMARY);
+
+      for (l = decoders; l; l = l->next)
+        load_feature (GST_PLUGIN_FEATURE (l->data));
+
+      gst_plugin_feature_list_free (decoders);
+    }
+
+  g_free (uri);
+
+  g_static_mutex_lock (&prewarm_lock);
+  prewarm_time = (g_get_monotonic_time () - started) * GST_USECOND;
+  g_static_mutex_unlock (&prewarm_lock);
+
+  return NULL;
+}
+
+/* Loads the registry and the plugins actors need on a worker thread,
+ * so the first actor and the first stream do not stall the UI. Call
+ * after gst_init (), e.g. while a splash screen is up. It also probes
+ * whether Xv takes YUV, which picks the actors' window sink. With
+ * @uri, a throwaway pipeline prerolls it to load its demuxer and
+ * decoders; otherwise primary-rank decoders and demuxers are loaded.
+ * Only the first call does anything.
+ */
+void
+clutter_gst_overlay_prewarm (const gchar *uri)
+{
+  g_static_mutex_lock (&prewarm_lock);
+
+  if (!prewarm_thread)
+    prewarm_thread = g_thread_create (prewarm_thread_run, g_strdup (uri),
+                                      FALSE, NULL);
+
+  g_static_mutex_unlock (&prewarm_lock);
+}
+
+/* GST_CLOCK_TIME_NONE while prewarming or if it never ran */
+GstClockTime
+clutter_gst_overlay_get_prewarm_time (void)
+{
+  GstClockTime time;
+
+  g_static_mutex_lock (&prewarm_lock);
+  time = prewarm_time;
+  g_static_mutex_unlock (&prewarm_lock);
+
+  return time;
+}
+
+/* Time taken to build the first actor of the process, for comparing
+ * runs with and without clutter_gst_overlay_prewarm ().
+ */
+GstClockTime
+clutter_gst_overlay_get_first_actor_latency (void)
+{
+  GstClockTime time;
+
+  g_static_mutex_lock (&prewarm_lock);
+  time = first_actor_latency;
+  g_static_mutex_unlock (&prewarm_lock);
+
+  return time;
+}
@@ -34,6 +34,8 @@
 G_BEGIN_DECLS
 
 #define CLUTTER_TYPE_GST_OVERLAY_ACTOR (clutter_gst_overlay_actor_get_type ())
+#define CLUTTER_TYPE_GST_OVERLAY_RENDER_MODE (clutter_gst_overlay_render_mode_get_type ())
+#define CLUTTER_TYPE_GST_OVERLAY_LATENCY_PROFILE (clutter_gst_overlay_latency_profile_get_type ())
 
 #define CLUTTER_GST_OVERLAY_ACTOR(obj) \
 	(G_TYPE_CHECK_INSTANCE_CAST ((obj), \
@@ -85,7 +87,44 @@ typedef enum {
   CLUTTER_GST_OVERLAY_STATE_ENDED   = (1 << 3)
 } ClutterGstOverlayStates;
 
+/* WINDOW moves a native X window under the stage (fast, but it cannot
+ * be clipped or blended); TEXTURE uploads frames into the actor itself;
+ * SHARED_WINDOW draws into a rectangle of one window per stage, so
+ * moving the actor moves no X window.
+ */
+typedef enum {
+  CLUTTER_GST_OVERLAY_RENDER_MODE_WINDOW,
+  CLUTTER_GST_OVERLAY_RENDER_MODE_TEXTURE,
+  CLUTTER_GST_OVERLAY_RENDER_MODE_SHARED_WINDOW
+} ClutterGstOverlayRenderMode;
+
+/* LIVE trades smoothness for latency on RTSP/UDP style sources */
+typedef enum {
+  CLUTTER_GST_OVERLAY_LATENCY_PROFILE_DEFAULT,
+  CLUTTER_GST_OVERLAY_LATENCY_PROFILE_LIVE
+} ClutterGstOverlayLatencyProfile;
+
+/* Filled in one pass by clutter_gst_overlay_actor_get_media_info ().
+ * Unknown values are -1 or GST_CLOCK_TIME_NONE; tags may be NULL.
+ */
+typedef struct {
+  gint          n_video;
+  gint          n_audio;
+  gint          n_text;
+  gint          current_video;
+  gint          current_audio;
+  gint          current_text;
+  gint          width;
+  gint          height;
+  GstClockTime  duration;
+  GstClockTime  position;
+  gboolean      can_seek;
+  GstTagList   *tags;
+} ClutterGstOverlayMediaInfo;
+
 GType                      clutter_gst_overlay_actor_get_type                      (void) G_GNUC_CONST;
+GType                      clutter_gst_overlay_render_mode_get_type                (void) G_GNUC_CONST;
+GType                      clutter_gst_overlay_latency_profile_get_type            (void) G_GNUC_CONST;
 ClutterActor *             clutter_gst_overlay_actor_new                           (void);
 ClutterActor *             clutter_gst_overlay_actor_new_with_uri                  (const gchar *uri);
 void                       clutter_gst_overlay_actor_play                          (ClutterGstOverlayActor *self);
@@ -96,7 +135,26 @@ gboolean                   clutter_gst_overlay_actor_get_mute
 void                       clutter_gst_overlay_actor_set_subtitle_flag             (ClutterGstOverlayActor *self, gboolean flag);
 gboolean                   clutter_gst_overlay_actor_get_subtitle_flag             (ClutterGstOverlayActor *self);
 gboolean                   clutter_gst_overlay_actor_get_video_size                (ClutterGstOverlayActor *self, gint *width, gint *height);
+gboolean                   clutter_gst_overlay_actor_get_video_format              (ClutterGstOverlayActor *self, gint *width, gint *height, gint *par_n, gint *par_d, gint *fps_n, gint *fps_d);
 ClutterGstOverlayStates    clutter_gst_overlay_actor_get_states                    (ClutterGstOverlayActor *self);
+GstElement *               clutter_gst_overlay_actor_get_pipeline                  (ClutterGstOverlayActor *self);
+GstBuffer *                clutter_gst_overlay_actor_snapshot_buffer               (ClutterGstOverlayActor *self);
+ClutterActor *             clutter_gst_overlay_actor_snapshot                      (ClutterGstOverlayActor *self);
+void                       clutter_gst_overlay_actor_set_fullscreen                (ClutterGstOverlayActor *self, gboolean fullscreen);
+gboolean                   clutter_gst_overlay_actor_get_fullscreen                (ClutterGstOverlayActor *self);
+void                       clutter_gst_overlay_actor_get_media_info                (ClutterGstOverlayActor *self, ClutterGstOverlayMediaInfo *info);
+void                       clutter_gst_overlay_media_info_clear                    (ClutterGstOverlayMediaInfo *info);
+
+void                       clutter_gst_overlay_get_x_stats                         (guint *requests);
+void                       clutter_gst_overlay_set_default_decoder_threads         (gint threads);
+gint                       clutter_gst_overlay_get_default_decoder_threads         (void);
+void                       clutter_gst_overlay_set_decode_budget                   (gint threads);
+gint                       clutter_gst_overlay_get_decode_budget                   (void);
+void                       clutter_gst_overlay_set_memory_budget                   (guint64 bytes);
+guint64                    clutter_gst_overlay_get_memory_budget                   (void);
+void                       clutter_gst_overlay_prewarm                             (const gchar *uri);
+GstClockTime               clutter_gst_overlay_get_prewarm_time                    (void);
+GstClockTime               clutter_gst_overlay_get_first_actor_latency             (void);
 
 G_END_DECLS
 
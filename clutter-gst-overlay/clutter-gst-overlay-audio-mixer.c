@@ -0,0 +1,379 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-audio-mixer.c - One shared audio output for all
+ *                                     actors.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-audio-mixer.h"
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+/* Every channel is converted to this before mixing */
+#define MIX_CAPS "audio/x-raw-int, endianness = (int) BYTE_ORDER, " \
+                 "signed = (boolean) true, width = (int) 16, "      \
+                 "depth = (int) 16, rate = (int) 44100, channels = (int) 2"
+
+/* Queued audio per channel before new buffers are dropped */
+#define CHANNEL_MAX_BYTES (64 * 1024)
+
+struct _ClutterGstOverlayAudioChannel
+{
+  /* In the actor's playbin2 */
+  GstElement *sink;
+
+  /* In the mixer pipeline */
+  GstElement *src;
+  GstElement *volume;
+  GstPad     *mixer_pad;
+
+  gboolean    full;
+};
+
+static GStaticMutex  mixer_lock = G_STATIC_MUTEX_INIT;
+static GstElement   *mixer = NULL;
+static GstElement   *mixer_adder = NULL;
+static GstElement   *mixer_sink = NULL;
+static guint         n_channels = 0;
+
+/* @sink replaces the default audio device, e.g. a fakesink or a
+ * filesink in tests. Takes effect when the mixer is next created.
+ */
+void
+clutter_gst_overlay_audio_mixer_set_sink (GstElement *sink)
+{
+  g_static_mutex_lock (&mixer_lock);
+
+  if (mixer_sink)
+    gst_object_unref (mixer_sink);
+
+  mixer_sink = sink ? gst_object_ref_sink (sink) : NULL;
+
+  g_static_mutex_unlock (&mixer_lock);
+}
+
+guint
+clutter_gst_overlay_audio_mixer_get_n_channels (void)
+{
+  return n_channels;
+}
+
+/* liveadder keeps mixing when a channel pauses or runs dry; plain
+ * adder would wait for every input.
+ */
+static gboolean
+ensure_mixer_locked (void)
+{
+  GstElement *convert, *sink;
+
+  if (mixer)
+    return TRUE;
+
+  mixer_adder = gst_element_factory_make ("liveadder", NULL);
+
+  if (!mixer_adder)
+    mixer_adder = gst_element_factory_make ("adder", NULL);
+
+  convert = gst_element_factory_make ("audioconvert", NULL);
+  sink = mixer_sink ? gst_object_ref (mixer_sink) :
+                      gst_element_factory_make ("autoaudiosink", NULL);
+
+  if (!mixer_adder || !convert || !sink)
+    {
+      if (mixer_adder)
+        gst_object_unref (mixer_adder);
+      if (convert)
+        gst_object_unref (convert);
+      if (sink)
+        gst_object_unref (sink);
+
+      mixer_adder = NULL;
+      return FALSE;
+    }
+
+  mixer = gst_pipeline_new ("audio-mixer");
+  gst_bin_add_many (GST_BIN (mixer), mixer_adder, convert, sink, NULL);
+  gst_element_link_many (mixer_adder, convert, sink, NULL);
+
+  gst_element_set_state (mixer, GST_STATE_PLAYING);
+
+  return TRUE;
+}
+
+static void
+channel_need_data (GstAppSrc *src,
+                   guint      length,
+                   gpointer   data)
+{
+  ((ClutterGstOverlayAudioChannel *) data)->full = FALSE;
+}
+
+static void
+channel_enough_data (GstAppSrc *src,
+                     gpointer   data)
+{
+  ((ClutterGstOverlayAudioChannel *) data)->full = TRUE;
+}
+
+/* Streaming thread of the actor's pipeline. The mixer stamps buffers
+ * with its own running time on arrival.
+ */
+static GstFlowReturn
+channel_new_buffer (GstAppSink *sink,
+                    gpointer    data)
+{
+  ClutterGstOverlayAudioChannel *channel = data;
+  GstBuffer *buffer = gst_app_sink_pull_buffer (sink);
+
+  if (!buffer)
+    return GST_FLOW_UNEXPECTED;
+
+  if (channel->full)
+    {
+      gst_buffer_unref (buffer);
+      return GST_FLOW_OK;
+    }
+
+  buffer = gst_buffer_make_metadata_writable (buffer);
+  GST_BUFFER_TIMESTAMP (buffer) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_OFFSET (buffer) = GST_BUFFER_OFFSET_NONE;
+
+  gst_app_src_push_buffer (GST_APP_SRC (channel->src), buffer);
+
+  return GST_FLOW_OK;
+}
+
+static GstElement *
+make_channel_sink (ClutterGstOverlayAudioChannel *channel,
+                   GstCaps                       *caps)
+{
+  static GstAppSinkCallbacks callbacks = {
+    NULL,
+    NULL,
+    channel_new_buffer,
+    NULL
+  };
+  GstElement *bin, *convert, *resample, *sink;
+  GstPad *pad;
+
+  convert = gst_element_factory_make ("audioconvert", NULL);
+  resample = gst_element_factory_make ("audioresample", NULL);
+  sink = gst_element_factory_make ("appsink", NULL);
+
+  if (!convert || !resample || !sink)
+    {
+      if (convert)
+        gst_object_unref (convert);
+      if (resample)
+        gst_object_unref (resample);
+      if (sink)
+        gst_object_unref (sink);
+
+      return NULL;
+    }
+
+  /* sync paces the actor's pipeline like a real audio sink would */
+  g_object_set (G_OBJECT (sink),
+                "caps", caps,
+                "sync", TRUE,
+                "max-buffers", 4,
+                "drop", TRUE,
+                NULL);
+  gst_app_sink_set_callbacks (GST_APP_SINK (sink), &callbacks, channel, NULL);
+
+  bin = gst_bin_new ("shared-audio");
+  gst_bin_add_many (GST_BIN (bin), convert, resample, sink, NULL);
+  gst_element_link_many (convert, resample, sink, NULL);
+
+  pad = gst_element_get_static_pad (convert, "sink");
+  gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+  gst_object_unref (pad);
+
+  return gst_object_ref_sink (bin);
+}
+
+/* Returns NULL if the mixer or channel elements cannot be created */
+ClutterGstOverlayAudioChannel *
+clutter_gst_overlay_audio_channel_new (void)
+{
+  static GstAppSrcCallbacks callbacks = {
+    channel_need_data,
+    channel_enough_data,
+    NULL
+  };
+  ClutterGstOverlayAudioChannel *channel;
+  GstCaps *caps;
+  GstPad *pad;
+
+  channel = g_slice_new0 (ClutterGstOverlayAudioChannel);
+
+  g_static_mutex_lock (&mixer_lock);
+
+  if (!ensure_mixer_locked ())
+    goto failed;
+
+  caps = gst_caps_from_string (MIX_CAPS);
+  channel->sink = make_channel_sink (channel, caps);
+  channel->src = gst_element_factory_make ("appsrc", NULL);
+  channel->volume = gst_element_factory_make ("volume", NULL);
+
+  if (!channel->sink || !channel->src || !channel->volume)
+    {
+      gst_caps_unref (caps);
+
+      if (channel->sink)
+        gst_object_unref (channel->sink);
+      if (channel->src)
+        gst_object_unref (channel->src);
+      if (channel->volume)
+        gst_object_unref (channel->volume);
+
+      goto failed;
+    }
+
+  g_object_set (G_OBJECT (channel->src),
+                "caps", caps,
+                "format", GST_FORMAT_TIME,
+                "is-live", TRUE,
+                "do-timestamp", TRUE,
+                "max-bytes", (guint64) CHANNEL_MAX_BYTES,
+                NULL);
+  gst_app_src_set_callbacks (GST_APP_SRC (channel->src), &callbacks,
+                             channel, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (mixer), channel->src, channel->volume, NULL);
+  gst_element_link (channel->src, channel->volume);
+
+  channel->mixer_pad = gst_element_get_request_pad (mixer_adder, "sink%d");
+  pad = gst_element_get_static_pad (channel->volume, "src");
+  gst_pad_link (pad, channel->mixer_pad);
+  gst_object_unref (pad);
+
+  gst_element_sync_state_with_parent (channel->volume);
+  gst_element_sync_state_with_parent (channel->src);
+
+  n_channels++;
+
+  g_static_mutex_unlock (&mixer_lock);
+
+  return channel;
+
+failed:
+  if (mixer && n_channels == 0)
+    {
+      gst_element_set_state (mixer, GST_STATE_NULL);
+      gst_object_unref (mixer);
+      mixer = mixer_adder = NULL;
+    }
+
+  g_static_mutex_unlock (&mixer_lock);
+
+  g_slice_free (ClutterGstOverlayAudioChannel, channel);
+
+  return NULL;
+}
+
+/* The actor's pipeline must be stopped first */
+void
+clutter_gst_overlay_audio_channel_free (ClutterGstOverlayAudioChannel *channel)
+{
+  g_return_if_fail (channel != NULL);
+
+  g_static_mutex_lock (&mixer_lock);
+
+  gst_element_set_state (channel->src, GST_STATE_NULL);
+  gst_element_set_state (channel->volume, GST_STATE_NULL);
+
+  gst_element_unlink (channel->src, channel->volume);
+  gst_element_release_request_pad (mixer_adder, channel->mixer_pad);
+  gst_object_unref (channel->mixer_pad);
+
+  gst_bin_remove_many (GST_BIN (mixer), channel->src, channel->volume, NULL);
+
+  if (--n_channels == 0)
+    {
+      gst_element_set_state (mixer, GST_STATE_NULL);
+      gst_object_unref (mixer);
+      mixer = mixer_adder = NULL;
+    }
+
+  g_static_mutex_unlock (&mixer_lock);
+
+  gst_object_unref (channel->sink);
+
+  g_slice_free (ClutterGstOverlayAudioChannel, channel);
+}
+
+/* For playbin2's audio-sink; owned by the channel */
+GstElement *
+clutter_gst_overlay_audio_channel_get_sink (ClutterGstOverlayAudioChannel *channel)
+{
+  g_return_val_if_fail (channel != NULL, NULL);
+
+  return channel->sink;
+}
+
+void
+clutter_gst_overlay_audio_channel_set_volume (ClutterGstOverlayAudioChannel *channel,
+                                              gdouble                        volume)
+{
+  g_return_if_fail (channel != NULL);
+
+  g_object_set (G_OBJECT (channel->volume), "volume", volume, NULL);
+}
+
+gdouble
+clutter_gst_overlay_audio_channel_get_volume (ClutterGstOverlayAudioChannel *channel)
+{
+  gdouble volume = 0;
+
+  g_return_val_if_fail (channel != NULL, 0);
+
+  g_object_get (G_OBJECT (channel->volume), "volume", &volume, NULL);
+
+  return volume;
+}
+
+void
+clutter_gst_overlay_audio_channel_set_mute (ClutterGstOverlayAudioChannel *channel,
+                                            gboolean                       mute)
+{
+  g_return_if_fail (channel != NULL);
+
+  g_object_set (G_OBJECT (channel->volume), "mute", mute, NULL);
+}
+
+gboolean
+clutter_gst_overlay_audio_channel_get_mute (ClutterGstOverlayAudioChannel *channel)
+{
+  gboolean mute = FALSE;
+
+  g_return_val_if_fail (channel != NULL, FALSE);
+
+  g_object_get (G_OBJECT (channel->volume), "mute", &mute, NULL);
+
+  return mute;
+}
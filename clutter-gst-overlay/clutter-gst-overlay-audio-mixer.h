@@ -0,0 +1,53 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_AUDIO_MIXER_H__
+#define __CLUTTER_GST_OVERLAY_AUDIO_MIXER_H__
+
+/* clutter-gst-overlay-audio-mixer.h */
+
+#include <glib.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Process-wide mixer with one connection to the audio device. Each
+ * channel is an audio sink for one playbin2, mixed with its own gain.
+ */
+typedef struct _ClutterGstOverlayAudioChannel ClutterGstOverlayAudioChannel;
+
+void                              clutter_gst_overlay_audio_mixer_set_sink        (GstElement *sink);
+guint                             clutter_gst_overlay_audio_mixer_get_n_channels  (void);
+
+ClutterGstOverlayAudioChannel *   clutter_gst_overlay_audio_channel_new           (void);
+void                              clutter_gst_overlay_audio_channel_free          (ClutterGstOverlayAudioChannel *channel);
+GstElement *                      clutter_gst_overlay_audio_channel_get_sink      (ClutterGstOverlayAudioChannel *channel);
+void                              clutter_gst_overlay_audio_channel_set_volume    (ClutterGstOverlayAudioChannel *channel, gdouble volume);
+gdouble                           clutter_gst_overlay_audio_channel_get_volume    (ClutterGstOverlayAudioChannel *channel);
+void                              clutter_gst_overlay_audio_channel_set_mute      (ClutterGstOverlayAudioChannel *channel, gboolean mute);
+gboolean                          clutter_gst_overlay_audio_channel_get_mute      (ClutterGstOverlayAudioChannel *channel);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_AUDIO_MIXER_H__ */
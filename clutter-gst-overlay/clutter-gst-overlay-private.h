@@ -0,0 +1,53 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-private.h - Definitions shared between the
+ *                                 clutter-gst-overlay sources.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_PRIVATE_H__
+#define __CLUTTER_GST_OVERLAY_PRIVATE_H__
+
+/* clutter-gst-overlay-private.h */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Mirrors GstPlayFlags of playbin2, which is not installed as a header */
+typedef enum {
+  GST_PLAY_FLAG_VIDEO         = (1 << 0),
+  GST_PLAY_FLAG_AUDIO         = (1 << 1),
+  GST_PLAY_FLAG_TEXT          = (1 << 2),
+  GST_PLAY_FLAG_VIS           = (1 << 3),
+  GST_PLAY_FLAG_SOFT_VOLUME   = (1 << 4),
+  GST_PLAY_FLAG_NATIVE_AUDIO  = (1 << 5),
+  GST_PLAY_FLAG_NATIVE_VIDEO  = (1 << 6),
+  GST_PLAY_FLAG_DOWNLOAD      = (1 << 7),
+  GST_PLAY_FLAG_BUFFERING     = (1 << 8),
+  GST_PLAY_FLAG_DEINTERLACE   = (1 << 9)
+} GstPlayFlags;
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_PRIVATE_H__ */
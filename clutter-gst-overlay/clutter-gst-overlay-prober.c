@@ -0,0 +1,581 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-prober.c - Bulk media probing for library listings,
+ *                                cached on disk.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-prober.h"
+#include <gst/pbutils/pbutils.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+
+#define CLUTTER_GST_OVERLAY_PROBER_GET_PRIVATE(obj) \
+        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+        CLUTTER_TYPE_GST_OVERLAY_PROBER, ClutterGstOverlayProberPrivate))
+
+#define PROBE_TIMEOUT         (5 * GST_SECOND)
+#define MAX_WORKER_THREADS    4
+#define SAVE_DELAY            2
+
+/* The cache is a key file with one group per path, named by the
+ * checksum of the path. An entry only counts while the file's mtime
+ * and size match the ones it was probed with.
+ */
+struct _ClutterGstOverlayProberPrivate
+{
+  gchar       *cache_file;
+
+  GMutex      *lock;
+  GKeyFile    *cache;
+  gboolean     dirty;
+  guint        save_source;
+
+  GThreadPool *pool;
+};
+
+typedef struct {
+  ClutterGstOverlayProber          *self;
+  gchar                            *path;
+
+  ClutterGstOverlayProberCallback   callback;
+  gpointer                          user_data;
+
+  ClutterGstOverlayProbeInfo        info;
+  gboolean                          found;
+  GError                           *error;
+} ProbeRequest;
+
+enum {
+  PROP_0,
+
+  PROP_CACHE_FILE
+};
+
+G_DEFINE_TYPE (ClutterGstOverlayProber,
+               clutter_gst_overlay_prober,
+               G_TYPE_OBJECT);
+
+static gchar *
+get_probe_group (const gchar *path)
+{
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA1, path, -1);
+}
+
+static gboolean
+stat_file (const gchar *path,
+           gint64      *mtime,
+           guint64     *size,
+           GError     **error)
+{
+  struct stat st;
+
+  if (g_stat (path, &st) != 0)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "Unable to stat %s: %s", path, g_strerror (errno));
+      return FALSE;
+    }
+
+  *mtime = st.st_mtime;
+  *size = st.st_size;
+
+  return TRUE;
+}
+
+/* Call with lock held */
+static gboolean
+read_entry_locked (ClutterGstOverlayProber    *self,
+                   const gchar                *group,
+                   gint64                      mtime,
+                   guint64                     size,
+                   ClutterGstOverlayProbeInfo *info)
+{
+  GKeyFile *cache = self->priv->cache;
+
+  if (!g_key_file_has_group (cache, group) ||
+      g_key_file_get_int64 (cache, group, "mtime", NULL) != mtime ||
+      g_key_file_get_uint64 (cache, group, "size", NULL) != size)
+    return FALSE;
+
+  info->duration = g_key_file_get_uint64 (cache, group, "duration", NULL);
+  info->width = g_key_file_get_integer (cache, group, "width", NULL);
+  info->height = g_key_file_get_integer (cache, group, "height", NULL);
+  info->n_video = g_key_file_get_integer (cache, group, "n-video", NULL);
+  info->n_audio = g_key_file_get_integer (cache, group, "n-audio", NULL);
+  info->n_text = g_key_file_get_integer (cache, group, "n-text", NULL);
+  info->seekable = g_key_file_get_boolean (cache, group, "seekable", NULL);
+
+  return TRUE;
+}
+
+/* Call with lock held */
+static void
+write_entry_locked (ClutterGstOverlayProber          *self,
+                    const gchar                      *group,
+                    const gchar                      *path,
+                    gint64                            mtime,
+                    guint64                           size,
+                    const ClutterGstOverlayProbeInfo *info)
+{
+  GKeyFile *cache = self->priv->cache;
+
+  g_key_file_set_string (cache, group, "path", path);
+  g_key_file_set_int64 (cache, group, "mtime", mtime);
+  g_key_file_set_uint64 (cache, group, "size", size);
+  g_key_file_set_uint64 (cache, group, "duration", info->duration);
+  g_key_file_set_integer (cache, group, "width", info->width);
+  g_key_file_set_integer (cache, group, "height", info->height);
+  g_key_file_set_integer (cache, group, "n-video", info->n_video);
+  g_key_file_set_integer (cache, group, "n-audio", info->n_audio);
+  g_key_file_set_integer (cache, group, "n-text", info->n_text);
+  g_key_file_set_boolean (cache, group, "seekable", info->seekable);
+
+  self->priv->dirty = TRUE;
+}
+
+/* Call with lock held. Entries of changed or removed files are
+ * dropped as they are probed again, so the file does not only grow.
+ */
+static void
+drop_entry_locked (ClutterGstOverlayProber *self,
+                   const gchar             *group)
+{
+  if (g_key_file_remove_group (self->priv->cache, group, NULL))
+    self->priv->dirty = TRUE;
+}
+
+/* uridecodebin only: no sinks, no window, no decoding past the caps */
+static gboolean
+discover_file (const gchar                *path,
+               ClutterGstOverlayProbeInfo *info,
+               GError                    **error)
+{
+  GstDiscoverer *discoverer;
+  GstDiscovererInfo *result;
+  GList *streams;
+  gboolean found = FALSE;
+  gchar *uri;
+
+  uri = gst_filename_to_uri (path, error);
+
+  if (!uri)
+    return FALSE;
+
+  discoverer = gst_discoverer_new (PROBE_TIMEOUT, error);
+
+  if (!discoverer)
+    {
+      g_free (uri);
+      return FALSE;
+    }
+
+  result = gst_discoverer_discover_uri (discoverer, uri, error);
+
+  if (result && gst_discoverer_info_get_result (result) == GST_DISCOVERER_OK)
+    {
+      info->duration = gst_discoverer_info_get_duration (result);
+      info->seekable = gst_discoverer_info_get_seekable (result);
+
+      streams = gst_discoverer_info_get_video_streams (result);
+      info->n_video = g_list_length (streams);
+      info->width = streams ?
+                    gst_discoverer_video_info_get_width (streams->data) : 0;
+      info->height = streams ?
+                     gst_discoverer_video_info_get_height (streams->data) : 0;
+      gst_discoverer_stream_info_list_free (streams);
+
+      streams = gst_discoverer_info_get_audio_streams (result);
+      info->n_audio = g_list_length (streams);
+      gst_discoverer_stream_info_list_free (streams);
+
+      streams = gst_discoverer_info_get_subtitle_streams (result);
+      info->n_text = g_list_length (streams);
+      gst_discoverer_stream_info_list_free (streams);
+
+      found = TRUE;
+    }
+  else if (error && !*error)
+    g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_TYPE_NOT_FOUND,
+                 "Unable to probe %s", path);
+
+  if (result)
+    gst_discoverer_info_unref (result);
+
+  g_object_unref (discoverer);
+  g_free (uri);
+
+  return found;
+}
+
+static void
+clutter_gst_overlay_prober_set_property (GObject      *object,
+                                         guint         property_id,
+                                         const GValue *value,
+                                         GParamSpec   *pspec)
+{
+  ClutterGstOverlayProber *self = CLUTTER_GST_OVERLAY_PROBER (object);
+
+  switch (property_id)
+    {
+    case PROP_CACHE_FILE:
+      g_free (self->priv->cache_file);
+      self->priv->cache_file = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+clutter_gst_overlay_prober_get_property (GObject    *object,
+                                         guint       property_id,
+                                         GValue     *value,
+                                         GParamSpec *pspec)
+{
+  ClutterGstOverlayProber *self = CLUTTER_GST_OVERLAY_PROBER (object);
+
+  switch (property_id)
+    {
+    case PROP_CACHE_FILE:
+      g_value_set_string (value, self->priv->cache_file);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+clutter_gst_overlay_prober_constructed (GObject *gobject)
+{
+  ClutterGstOverlayProberPrivate *priv = CLUTTER_GST_OVERLAY_PROBER (gobject)->priv;
+  gchar *dir;
+
+  if (!priv->cache_file)
+    priv->cache_file = g_build_filename (g_get_user_cache_dir (),
+                                         "clutter-gst-overlay",
+                                         "probe.cache",
+                                         NULL);
+
+  dir = g_path_get_dirname (priv->cache_file);
+
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    g_warning ("Unable to create probe cache directory %s\n", dir);
+
+  g_free (dir);
+
+  /* A missing or broken cache just starts empty */
+  g_key_file_load_from_file (priv->cache, priv->cache_file,
+                             G_KEY_FILE_NONE, NULL);
+}
+
+static void
+clutter_gst_overlay_prober_dispose (GObject *gobject)
+{
+  ClutterGstOverlayProber *self = CLUTTER_GST_OVERLAY_PROBER (gobject);
+  ClutterGstOverlayProberPrivate *priv = self->priv;
+
+  if (priv->pool)
+    {
+      /* Each queued ProbeRequest owns a ref on the prober, so no
+       * worker can still be running by the time dispose is reached.
+       */
+      g_thread_pool_free (priv->pool, TRUE, TRUE);
+
+      priv->pool = NULL;
+    }
+
+  if (priv->save_source)
+    {
+      g_source_remove (priv->save_source);
+      priv->save_source = 0;
+    }
+
+  if (priv->dirty)
+    clutter_gst_overlay_prober_save (self, NULL);
+
+  G_OBJECT_CLASS (clutter_gst_overlay_prober_parent_class)->dispose (gobject);
+}
+
+static void
+clutter_gst_overlay_prober_finalize (GObject *gobject)
+{
+  ClutterGstOverlayProberPrivate *priv = CLUTTER_GST_OVERLAY_PROBER (gobject)->priv;
+
+  g_key_file_free (priv->cache);
+  g_mutex_free (priv->lock);
+  g_free (priv->cache_file);
+
+  G_OBJECT_CLASS (clutter_gst_overlay_prober_parent_class)->finalize (gobject);
+}
+
+static gboolean
+save_timeout (gpointer data)
+{
+  ClutterGstOverlayProber *self = CLUTTER_GST_OVERLAY_PROBER (data);
+  GError *error = NULL;
+
+  self->priv->save_source = 0;
+
+  if (!clutter_gst_overlay_prober_save (self, &error))
+    {
+      g_warning ("Unable to save probe cache: %s\n", error->message);
+      g_error_free (error);
+    }
+
+  return FALSE;
+}
+
+/* Results arrive one by one; the cache is written once they settle */
+static gboolean
+probe_request_complete (gpointer data)
+{
+  ProbeRequest *request = data;
+  ClutterGstOverlayProberPrivate *priv = request->self->priv;
+
+  if (request->callback)
+    request->callback (request->self, request->path,
+                       request->found ? &request->info : NULL,
+                       request->error, request->user_data);
+
+  if (priv->dirty && !priv->save_source && priv->pool)
+    priv->save_source = g_timeout_add_seconds (SAVE_DELAY, save_timeout,
+                                               request->self);
+
+  if (request->error)
+    g_error_free (request->error);
+
+  g_object_unref (request->self);
+  g_free (request->path);
+  g_slice_free (ProbeRequest, request);
+
+  return FALSE;
+}
+
+static void
+probe_request_run (gpointer data,
+                   gpointer user_data)
+{
+  ProbeRequest *request = data;
+
+  request->found = clutter_gst_overlay_prober_probe (request->self,
+                                                     request->path,
+                                                     &request->info,
+                                                     &request->error);
+
+  g_idle_add (probe_request_complete, request);
+}
+
+static void
+clutter_gst_overlay_prober_init (ClutterGstOverlayProber *self)
+{
+  ClutterGstOverlayProberPrivate *priv;
+
+  self->priv = priv = CLUTTER_GST_OVERLAY_PROBER_GET_PRIVATE (self);
+
+  priv->lock = g_mutex_new ();
+  priv->cache = g_key_file_new ();
+  priv->pool = g_thread_pool_new (probe_request_run, NULL,
+                                  MAX_WORKER_THREADS, FALSE, NULL);
+}
+
+static void
+clutter_gst_overlay_prober_class_init (ClutterGstOverlayProberClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (ClutterGstOverlayProberPrivate));
+
+  gobject_class->constructed = clutter_gst_overlay_prober_constructed;
+  gobject_class->dispose = clutter_gst_overlay_prober_dispose;
+  gobject_class->finalize = clutter_gst_overlay_prober_finalize;
+  gobject_class->set_property = clutter_gst_overlay_prober_set_property;
+  gobject_class->get_property = clutter_gst_overlay_prober_get_property;
+
+  pspec = g_param_spec_string ("cache-file",
+                               "Cache file",
+                               "Key file holding the probe results",
+                               NULL,
+                               G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CACHE_FILE, pspec);
+}
+
+ClutterGstOverlayProber *
+clutter_gst_overlay_prober_new (const gchar *cache_file)
+{
+  return g_object_new (CLUTTER_TYPE_GST_OVERLAY_PROBER,
+                       "cache-file", cache_file, NULL);
+}
+
+/* A hit costs one stat () and a key file lookup; GStreamer is not
+ * involved. Returns FALSE for anything not cached or out of date.
+ */
+gboolean
+clutter_gst_overlay_prober_lookup (ClutterGstOverlayProber    *self,
+                                   const gchar                *path,
+                                   ClutterGstOverlayProbeInfo *info)
+{
+  gint64 mtime;
+  guint64 size;
+  gboolean found;
+  gchar *group;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_PROBER (self), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (info != NULL, FALSE);
+
+  if (!stat_file (path, &mtime, &size, NULL))
+    return FALSE;
+
+  group = get_probe_group (path);
+
+  g_mutex_lock (self->priv->lock);
+  found = read_entry_locked (self, group, mtime, size, info);
+  g_mutex_unlock (self->priv->lock);
+
+  g_free (group);
+
+  return found;
+}
+
+/* On a miss, runs GstDiscoverer on the calling thread for up to
+ * PROBE_TIMEOUT. UI code should go through clutter_gst_overlay_prober_request.
+ */
+gboolean
+clutter_gst_overlay_prober_probe (ClutterGstOverlayProber    *self,
+                                  const gchar                *path,
+                                  ClutterGstOverlayProbeInfo *info,
+                                  GError                    **error)
+{
+  gint64 mtime;
+  guint64 size;
+  gchar *group;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_PROBER (self), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (info != NULL, FALSE);
+
+  group = get_probe_group (path);
+
+  if (!stat_file (path, &mtime, &size, error))
+    {
+      g_mutex_lock (self->priv->lock);
+      drop_entry_locked (self, group);
+      g_mutex_unlock (self->priv->lock);
+
+      g_free (group);
+      return FALSE;
+    }
+
+  g_mutex_lock (self->priv->lock);
+
+  if (read_entry_locked (self, group, mtime, size, info))
+    {
+      g_mutex_unlock (self->priv->lock);
+      g_free (group);
+      return TRUE;
+    }
+
+  drop_entry_locked (self, group);
+
+  g_mutex_unlock (self->priv->lock);
+
+  if (!discover_file (path, info, error))
+    {
+      g_free (group);
+      return FALSE;
+    }
+
+  g_mutex_lock (self->priv->lock);
+  write_entry_locked (self, group, path, mtime, size, info);
+  g_mutex_unlock (self->priv->lock);
+
+  g_free (group);
+
+  return TRUE;
+}
+
+/* The callback runs on the main loop, straight away for cached files.
+ * At most MAX_WORKER_THREADS files are probed at once.
+ */
+void
+clutter_gst_overlay_prober_request (ClutterGstOverlayProber         *self,
+                                    const gchar                     *path,
+                                    ClutterGstOverlayProberCallback  callback,
+                                    gpointer                         user_data)
+{
+  ProbeRequest *request;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_PROBER (self));
+  g_return_if_fail (path != NULL);
+
+  request = g_slice_new0 (ProbeRequest);
+  request->self = g_object_ref (self);
+  request->path = g_strdup (path);
+  request->callback = callback;
+  request->user_data = user_data;
+
+  request->found = clutter_gst_overlay_prober_lookup (self, path,
+                                                      &request->info);
+
+  if (request->found)
+    g_idle_add (probe_request_complete, request);
+  else
+    g_thread_pool_push (self->priv->pool, request, NULL);
+}
+
+/* Writes the cache file; also done on its own shortly after
+ * requests complete and when the prober goes away.
+ */
+gboolean
+clutter_gst_overlay_prober_save (ClutterGstOverlayProber *self,
+                                 GError                 **error)
+{
+  ClutterGstOverlayProberPrivate *priv;
+  gchar *data;
+  gsize length;
+  gboolean result;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_PROBER (self), FALSE);
+
+  priv = self->priv;
+
+  g_mutex_lock (priv->lock);
+  data = g_key_file_to_data (priv->cache, &length, NULL);
+  priv->dirty = FALSE;
+  g_mutex_unlock (priv->lock);
+
+  result = g_file_set_contents (priv->cache_file, data, length, error);
+
+  g_free (data);
+
+  return result;
+}
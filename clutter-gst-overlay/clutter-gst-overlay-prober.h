@@ -0,0 +1,100 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_PROBER_H__
+#define __CLUTTER_GST_OVERLAY_PROBER_H__
+
+/* clutter-gst-overlay-prober.h */
+
+#include <glib-object.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define CLUTTER_TYPE_GST_OVERLAY_PROBER (clutter_gst_overlay_prober_get_type ())
+
+#define CLUTTER_GST_OVERLAY_PROBER(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_PROBER, ClutterGstOverlayProber))
+
+#define CLUTTER_GST_OVERLAY_PROBER_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST ((klass), \
+	CLUTTER_TYPE_GST_OVERLAY_PROBER, ClutterGstOverlayProberClass))
+
+#define CLUTTER_IS_GST_OVERLAY_PROBER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_PROBER))
+
+#define CLUTTER_IS_GST_OVERLAY_PROBER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), \
+	CLUTTER_TYPE_GST_OVERLAY_PROBER))
+
+#define CLUTTER_GST_OVERLAY_PROBER_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_PROBER, ClutterGstOverlayProberClass))
+
+typedef struct _ClutterGstOverlayProber         ClutterGstOverlayProber;
+typedef struct _ClutterGstOverlayProberClass    ClutterGstOverlayProberClass;
+typedef struct _ClutterGstOverlayProberPrivate  ClutterGstOverlayProberPrivate;
+
+struct _ClutterGstOverlayProber
+{
+  GObject                          parent;
+  ClutterGstOverlayProberPrivate  *priv;
+};
+
+struct _ClutterGstOverlayProberClass
+{
+  GObjectClass parent_class;
+};
+
+/* What a media browser lists for a file. Width and height are those
+ * of the first video stream, 0 without video.
+ */
+typedef struct {
+  GstClockTime  duration;
+  gint          width;
+  gint          height;
+  gint          n_video;
+  gint          n_audio;
+  gint          n_text;
+  gboolean      seekable;
+} ClutterGstOverlayProbeInfo;
+
+typedef void (* ClutterGstOverlayProberCallback) (ClutterGstOverlayProber          *prober,
+                                                  const gchar                      *path,
+                                                  const ClutterGstOverlayProbeInfo *info,
+                                                  const GError                     *error,
+                                                  gpointer                          user_data);
+
+GType                      clutter_gst_overlay_prober_get_type      (void) G_GNUC_CONST;
+ClutterGstOverlayProber *  clutter_gst_overlay_prober_new           (const gchar *cache_file);
+gboolean                   clutter_gst_overlay_prober_lookup        (ClutterGstOverlayProber *self, const gchar *path, ClutterGstOverlayProbeInfo *info);
+gboolean                   clutter_gst_overlay_prober_probe         (ClutterGstOverlayProber *self, const gchar *path, ClutterGstOverlayProbeInfo *info, GError **error);
+void                       clutter_gst_overlay_prober_request       (ClutterGstOverlayProber *self, const gchar *path, ClutterGstOverlayProberCallback callback, gpointer user_data);
+gboolean                   clutter_gst_overlay_prober_save          (ClutterGstOverlayProber *self, GError **error);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_PROBER_H__ */
@@ -0,0 +1,424 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-subtitles.c - In-memory SubRip timeline shared
+ *                                   between actors.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-subtitles.h"
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  GstClockTime  start;
+  GstClockTime  end;
+  gchar        *text;
+} Cue;
+
+struct _ClutterGstOverlaySubtitles
+{
+  volatile gint  ref_count;
+  gchar         *uri;
+
+  /* Sorted and disjoint; overlapping cues are merged into one
+   * interval per distinct set of visible lines.
+   */
+  GArray        *intervals;
+  guint          n_cues;
+};
+
+static GStaticMutex  subtitles_lock = G_STATIC_MUTEX_INIT;
+static GHashTable   *subtitles_by_uri = NULL;
+
+static gboolean
+parse_timestamp (const gchar  *str,
+                 GstClockTime *time)
+{
+  guint h, m, s, ms;
+
+  if (sscanf (str, "%u:%u:%u%*1[,.]%u", &h, &m, &s, &ms) != 4)
+    return FALSE;
+
+  *time = ((h * 60 + m) * 60 + s) * GST_SECOND + ms * GST_MSECOND;
+
+  return TRUE;
+}
+
+static gboolean
+parse_timing (const gchar  *line,
+              GstClockTime *start,
+              GstClockTime *end)
+{
+  const gchar *arrow = strstr (line, "-->");
+
+  if (!arrow)
+    return FALSE;
+
+  arrow += 3;
+  arrow += strspn (arrow, " \t");
+
+  return parse_timestamp (line, start) &&
+         parse_timestamp (arrow, end) &&
+         *end > *start;
+}
+
+static GArray *
+parse_srt (gchar *contents)
+{
+  GArray *cues = g_array_new (FALSE, FALSE, sizeof (Cue));
+  gchar **lines, **line;
+  GString *text = NULL;
+  Cue cue;
+
+  /* Skip a UTF-8 byte order mark */
+  if (g_str_has_prefix (contents, "\xef\xbb\xbf"))
+    contents += 3;
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  for (line = lines; *line; line++)
+    {
+      g_strchomp (*line);
+
+      if (text)
+        {
+          if (**line)
+            {
+              if (text->len > 0)
+                g_string_append_c (text, '\n');
+              g_string_append (text, *line);
+              continue;
+            }
+
+          cue.text = g_string_free (text, FALSE);
+          g_array_append_val (cues, cue);
+          text = NULL;
+          continue;
+        }
+
+      /* Cue numbers and stray lines are skipped */
+      if (parse_timing (*line, &cue.start, &cue.end))
+        text = g_string_new (NULL);
+    }
+
+  if (text)
+    {
+      cue.text = g_string_free (text, FALSE);
+      g_array_append_val (cues, cue);
+    }
+
+  g_strfreev (lines);
+
+  return cues;
+}
+
+static gint
+compare_cues (gconstpointer a,
+              gconstpointer b)
+{
+  const Cue *cue_a = a, *cue_b = b;
+
+  return cue_a->start < cue_b->start ? -1 : cue_a->start > cue_b->start;
+}
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  GstClockTime time_a = *(const GstClockTime *) a;
+  GstClockTime time_b = *(const GstClockTime *) b;
+
+  return time_a < time_b ? -1 : time_a > time_b;
+}
+
+/* Sweeps the sorted cues over every start and end boundary, so each
+ * interval holds exactly the cues visible during it.
+ */
+static GArray *
+build_intervals (GArray *cues)
+{
+  GArray *intervals = g_array_new (FALSE, FALSE, sizeof (Cue));
+  GArray *bounds = g_array_sized_new (FALSE, FALSE, sizeof (GstClockTime),
+                                      cues->len * 2);
+  GPtrArray *active = g_ptr_array_new ();
+  guint i, j, next = 0;
+
+  g_array_sort (cues, compare_cues);
+
+  for (i = 0; i < cues->len; i++)
+    {
+      g_array_append_val (bounds, g_array_index (cues, Cue, i).start);
+      g_array_append_val (bounds, g_array_index (cues, Cue, i).end);
+    }
+
+  g_array_sort (bounds, compare_times);
+
+  for (i = 0; i + 1 < bounds->len; i++)
+    {
+      GstClockTime start = g_array_index (bounds, GstClockTime, i);
+      GstClockTime end = g_array_index (bounds, GstClockTime, i + 1);
+      GString *text;
+      Cue interval;
+
+      if (start == end)
+        continue;
+
+      while (next < cues->len && g_array_index (cues, Cue, next).start <= start)
+        g_ptr_array_add (active, &g_array_index (cues, Cue, next++));
+
+      for (j = 0; j < active->len; )
+        if (((Cue *) g_ptr_array_index (active, j))->end <= start)
+          g_ptr_array_remove_index (active, j);
+        else
+          j++;
+
+      if (active->len == 0)
+        continue;
+
+      text = g_string_new (NULL);
+
+      for (j = 0; j < active->len; j++)
+        {
+          if (j > 0)
+            g_string_append_c (text, '\n');
+          g_string_append (text, ((Cue *) g_ptr_array_index (active, j))->text);
+        }
+
+      interval.start = start;
+      interval.end = end;
+      interval.text = g_string_free (text, FALSE);
+      g_array_append_val (intervals, interval);
+    }
+
+  g_ptr_array_free (active, TRUE);
+  g_array_free (bounds, TRUE);
+
+  return intervals;
+}
+
+static void
+free_cues (GArray *cues)
+{
+  guint i;
+
+  for (i = 0; i < cues->len; i++)
+    g_free (g_array_index (cues, Cue, i).text);
+
+  g_array_free (cues, TRUE);
+}
+
+/* Only local SubRip files are indexed: they are read from the caller's
+ * thread, usually the main loop. Other formats and remote files are
+ * left to playbin2.
+ */
+gboolean
+clutter_gst_overlay_subtitles_supports (const gchar *uri)
+{
+  gchar *lower;
+  gboolean result;
+
+  g_return_val_if_fail (uri != NULL, FALSE);
+
+  lower = g_ascii_strdown (uri, -1);
+  result = g_str_has_prefix (lower, "file:") && g_str_has_suffix (lower, ".srt");
+  g_free (lower);
+
+  return result;
+}
+
+/* Returns the shared index for @uri, loading and parsing the file
+ * the first time. Release with clutter_gst_overlay_subtitles_unref ().
+ */
+ClutterGstOverlaySubtitles *
+clutter_gst_overlay_subtitles_get (const gchar  *uri,
+                                   GError      **error)
+{
+  ClutterGstOverlaySubtitles *subtitles;
+  GFile *file;
+  gchar *contents;
+  GArray *cues;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  g_static_mutex_lock (&subtitles_lock);
+
+  if (!subtitles_by_uri)
+    subtitles_by_uri = g_hash_table_new (g_str_hash, g_str_equal);
+
+  subtitles = g_hash_table_lookup (subtitles_by_uri, uri);
+
+  if (subtitles)
+    {
+      clutter_gst_overlay_subtitles_ref (subtitles);
+      g_static_mutex_unlock (&subtitles_lock);
+      return subtitles;
+    }
+
+  g_static_mutex_unlock (&subtitles_lock);
+
+  /* Loaded unlocked; a racing load of the same file loses below */
+  file = g_file_new_for_uri (uri);
+
+  if (!g_file_load_contents (file, NULL, &contents, NULL, NULL, error))
+    {
+      g_object_unref (file);
+      return NULL;
+    }
+
+  g_object_unref (file);
+
+  cues = parse_srt (contents);
+  g_free (contents);
+
+  subtitles = g_slice_new0 (ClutterGstOverlaySubtitles);
+  subtitles->ref_count = 1;
+  subtitles->uri = g_strdup (uri);
+  subtitles->n_cues = cues->len;
+  subtitles->intervals = build_intervals (cues);
+
+  free_cues (cues);
+
+  g_static_mutex_lock (&subtitles_lock);
+
+  if (g_hash_table_lookup (subtitles_by_uri, uri))
+    {
+      ClutterGstOverlaySubtitles *loaded = g_hash_table_lookup (subtitles_by_uri, uri);
+
+      clutter_gst_overlay_subtitles_ref (loaded);
+      g_static_mutex_unlock (&subtitles_lock);
+
+      clutter_gst_overlay_subtitles_unref (subtitles);
+      return loaded;
+    }
+
+  g_hash_table_insert (subtitles_by_uri, subtitles->uri, subtitles);
+
+  g_static_mutex_unlock (&subtitles_lock);
+
+  return subtitles;
+}
+
+ClutterGstOverlaySubtitles *
+clutter_gst_overlay_subtitles_ref (ClutterGstOverlaySubtitles *subtitles)
+{
+  g_return_val_if_fail (subtitles != NULL, NULL);
+
+  g_atomic_int_inc (&subtitles->ref_count);
+
+  return subtitles;
+}
+
+void
+clutter_gst_overlay_subtitles_unref (ClutterGstOverlaySubtitles *subtitles)
+{
+  g_return_if_fail (subtitles != NULL);
+
+  /* The table lock keeps a concurrent get from reviving it */
+  g_static_mutex_lock (&subtitles_lock);
+
+  if (!g_atomic_int_dec_and_test (&subtitles->ref_count))
+    {
+      g_static_mutex_unlock (&subtitles_lock);
+      return;
+    }
+
+  if (subtitles_by_uri &&
+      g_hash_table_lookup (subtitles_by_uri, subtitles->uri) == subtitles)
+    g_hash_table_remove (subtitles_by_uri, subtitles->uri);
+
+  g_static_mutex_unlock (&subtitles_lock);
+
+  free_cues (subtitles->intervals);
+  g_free (subtitles->uri);
+
+  g_slice_free (ClutterGstOverlaySubtitles, subtitles);
+}
+
+const gchar *
+clutter_gst_overlay_subtitles_get_uri (ClutterGstOverlaySubtitles *subtitles)
+{
+  g_return_val_if_fail (subtitles != NULL, NULL);
+
+  return subtitles->uri;
+}
+
+guint
+clutter_gst_overlay_subtitles_get_n_cues (ClutterGstOverlaySubtitles *subtitles)
+{
+  g_return_val_if_fail (subtitles != NULL, 0);
+
+  return subtitles->n_cues;
+}
+
+/* Returns the text visible at @time, or NULL. @start and @end, if
+ * given, receive the span over which the result stays the same, so
+ * callers only look up again once @time leaves it.
+ */
+const gchar *
+clutter_gst_overlay_subtitles_lookup (ClutterGstOverlaySubtitles *subtitles,
+                                      GstClockTime                time,
+                                      GstClockTime               *start,
+                                      GstClockTime               *end)
+{
+  GArray *intervals;
+  guint low = 0, high;
+  Cue *interval;
+
+  g_return_val_if_fail (subtitles != NULL, NULL);
+
+  intervals = subtitles->intervals;
+  high = intervals->len;
+
+  /* First interval ending after time */
+  while (low < high)
+    {
+      guint middle = (low + high) / 2;
+
+      if (g_array_index (intervals, Cue, middle).end <= time)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  interval = low < intervals->len ? &g_array_index (intervals, Cue, low) : NULL;
+
+  if (interval && interval->start <= time)
+    {
+      if (start)
+        *start = interval->start;
+      if (end)
+        *end = interval->end;
+
+      return interval->text;
+    }
+
+  if (start)
+    *start = low > 0 ? g_array_index (intervals, Cue, low - 1).end : 0;
+  if (end)
+    *end = interval ? interval->start : GST_CLOCK_TIME_NONE;
+
+  return NULL;
+}
@@ -0,0 +1,50 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_SUBTITLES_H__
+#define __CLUTTER_GST_OVERLAY_SUBTITLES_H__
+
+/* clutter-gst-overlay-subtitles.h */
+
+#include <glib.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* SubRip file parsed once into sorted, non-overlapping intervals.
+ * Indexes are shared by URI between all users in the process.
+ */
+typedef struct _ClutterGstOverlaySubtitles ClutterGstOverlaySubtitles;
+
+ClutterGstOverlaySubtitles *  clutter_gst_overlay_subtitles_get        (const gchar *uri, GError **error);
+ClutterGstOverlaySubtitles *  clutter_gst_overlay_subtitles_ref        (ClutterGstOverlaySubtitles *subtitles);
+void                          clutter_gst_overlay_subtitles_unref      (ClutterGstOverlaySubtitles *subtitles);
+const gchar *                 clutter_gst_overlay_subtitles_get_uri    (ClutterGstOverlaySubtitles *subtitles);
+guint                         clutter_gst_overlay_subtitles_get_n_cues (ClutterGstOverlaySubtitles *subtitles);
+const gchar *                 clutter_gst_overlay_subtitles_lookup     (ClutterGstOverlaySubtitles *subtitles, GstClockTime time, GstClockTime *start, GstClockTime *end);
+gboolean                      clutter_gst_overlay_subtitles_supports   (const gchar *uri);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_SUBTITLES_H__ */
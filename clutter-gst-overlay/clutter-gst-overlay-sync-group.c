@@ -0,0 +1,578 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-sync-group.c - Set of actors playing on one clock
+ *                                    and one base time.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-sync-group.h"
+#include <gst/net/gstnet.h>
+
+#define CLUTTER_GST_OVERLAY_SYNC_GROUP_GET_PRIVATE(obj) \
+        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+        CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP, ClutterGstOverlaySyncGroupPrivate))
+
+/* Time given to all pipelines to reach PLAYING before the common
+ * base time is reached.
+ */
+#define START_DELAY      (100 * GST_MSECOND)
+#define PREROLL_TIMEOUT  (5 * GST_SECOND)
+
+struct _ClutterGstOverlaySyncGroupPrivate
+{
+  GstClock     *clock;
+  GList        *actors;
+
+  /* Set while this process serves its clock to other hosts */
+  GstNetTimeProvider *time_provider;
+
+  /* Running time is clock time - base_time while playing, and
+   * frozen in running_time while paused. Stream position is
+   * segment_start + running time.
+   */
+  GstClockTime  base_time;
+  GstClockTime  running_time;
+  GstClockTime  segment_start;
+  gboolean      playing;
+};
+
+enum {
+  PROP_0,
+
+  PROP_CLOCK
+};
+
+G_DEFINE_TYPE (ClutterGstOverlaySyncGroup,
+               clutter_gst_overlay_sync_group,
+               G_TYPE_OBJECT);
+
+static GstElement *
+get_pipeline (gpointer actor)
+{
+  return clutter_gst_overlay_actor_get_pipeline (CLUTTER_GST_OVERLAY_ACTOR (actor));
+}
+
+static void
+attach_pipeline (ClutterGstOverlaySyncGroup *self,
+                 GstElement                 *pipeline)
+{
+  gst_pipeline_use_clock (GST_PIPELINE (pipeline), self->priv->clock);
+
+  /* Keep the pipeline from picking its own base time */
+  gst_element_set_start_time (pipeline, GST_CLOCK_TIME_NONE);
+}
+
+static void
+detach_pipeline (GstElement *pipeline)
+{
+  gst_pipeline_auto_clock (GST_PIPELINE (pipeline));
+  gst_element_set_start_time (pipeline, 0);
+}
+
+static void
+set_state_all (ClutterGstOverlaySyncGroup *self,
+               GstState                    state)
+{
+  GList *l;
+
+  for (l = self->priv->actors; l; l = l->next)
+    if (gst_element_set_state (get_pipeline (l->data), state) ==
+        GST_STATE_CHANGE_FAILURE)
+      g_warning ("Unable to change state of a synchronized actor\n");
+}
+
+static void
+wait_for_preroll (ClutterGstOverlaySyncGroup *self)
+{
+  GList *l;
+
+  for (l = self->priv->actors; l; l = l->next)
+    gst_element_get_state (get_pipeline (l->data), NULL, NULL,
+                           PREROLL_TIMEOUT);
+}
+
+static void
+start_all_at (ClutterGstOverlaySyncGroup *self,
+              GstClockTime                base_time)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv = self->priv;
+  GList *l;
+
+  priv->base_time = base_time;
+
+  for (l = priv->actors; l; l = l->next)
+    gst_element_set_base_time (get_pipeline (l->data), priv->base_time);
+
+  set_state_all (self, GST_STATE_PLAYING);
+}
+
+static void
+start_all (ClutterGstOverlaySyncGroup *self)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv = self->priv;
+
+  start_all_at (self, gst_clock_get_time (priv->clock) + START_DELAY -
+                      priv->running_time);
+}
+
+static void
+clutter_gst_overlay_sync_group_set_property (GObject      *object,
+                                             guint         property_id,
+                                             const GValue *value,
+                                             GParamSpec   *pspec)
+{
+  ClutterGstOverlaySyncGroup *self = CLUTTER_GST_OVERLAY_SYNC_GROUP (object);
+
+  switch (property_id)
+    {
+    case PROP_CLOCK:
+      self->priv->clock = g_value_dup_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+clutter_gst_overlay_sync_group_get_property (GObject    *object,
+                                             guint       property_id,
+                                             GValue     *value,
+                                             GParamSpec *pspec)
+{
+  ClutterGstOverlaySyncGroup *self = CLUTTER_GST_OVERLAY_SYNC_GROUP (object);
+
+  switch (property_id)
+    {
+    case PROP_CLOCK:
+      g_value_set_object (value, self->priv->clock);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+clutter_gst_overlay_sync_group_constructed (GObject *gobject)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv = CLUTTER_GST_OVERLAY_SYNC_GROUP (gobject)->priv;
+
+  if (!priv->clock)
+    priv->clock = gst_system_clock_obtain ();
+}
+
+static void
+clutter_gst_overlay_sync_group_dispose (GObject *gobject)
+{
+  ClutterGstOverlaySyncGroup *self = CLUTTER_GST_OVERLAY_SYNC_GROUP (gobject);
+  ClutterGstOverlaySyncGroupPrivate *priv = self->priv;
+
+  while (priv->actors)
+    clutter_gst_overlay_sync_group_remove_actor (self, priv->actors->data);
+
+  if (priv->time_provider)
+    {
+      gst_object_unref (priv->time_provider);
+      priv->time_provider = NULL;
+    }
+
+  if (priv->clock)
+    {
+      gst_object_unref (priv->clock);
+      priv->clock = NULL;
+    }
+
+  G_OBJECT_CLASS (clutter_gst_overlay_sync_group_parent_class)->dispose (gobject);
+}
+
+static void
+clutter_gst_overlay_sync_group_init (ClutterGstOverlaySyncGroup *self)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+
+  self->priv = priv = CLUTTER_GST_OVERLAY_SYNC_GROUP_GET_PRIVATE (self);
+
+  priv->clock = NULL;
+  priv->actors = NULL;
+  priv->time_provider = NULL;
+  priv->base_time = GST_CLOCK_TIME_NONE;
+  priv->running_time = 0;
+  priv->segment_start = 0;
+  priv->playing = FALSE;
+}
+
+static void
+clutter_gst_overlay_sync_group_class_init (ClutterGstOverlaySyncGroupClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (ClutterGstOverlaySyncGroupPrivate));
+
+  gobject_class->constructed = clutter_gst_overlay_sync_group_constructed;
+  gobject_class->dispose = clutter_gst_overlay_sync_group_dispose;
+  gobject_class->set_property = clutter_gst_overlay_sync_group_set_property;
+  gobject_class->get_property = clutter_gst_overlay_sync_group_get_property;
+
+  pspec = g_param_spec_object ("clock",
+                               "Clock",
+                               "Clock shared by all actors of the group",
+                               GST_TYPE_CLOCK,
+                               G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CLOCK, pspec);
+}
+
+ClutterGstOverlaySyncGroup *
+clutter_gst_overlay_sync_group_new (void)
+{
+  return g_object_new (CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP, NULL);
+}
+
+ClutterGstOverlaySyncGroup *
+clutter_gst_overlay_sync_group_new_with_clock (GstClock *clock)
+{
+  return g_object_new (CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP,
+                       "clock", clock, NULL);
+}
+
+/* Group slaved to the clock another process publishes with
+ * clutter_gst_overlay_sync_group_publish_clock().
+ */
+ClutterGstOverlaySyncGroup *
+clutter_gst_overlay_sync_group_new_net_slave (const gchar *address,
+                                              gint         port)
+{
+  ClutterGstOverlaySyncGroup *group;
+  GstClock *clock;
+
+  g_return_val_if_fail (address != NULL, NULL);
+
+  clock = gst_net_client_clock_new ("clutter-gst-overlay-net-clock",
+                                    address, port, 0);
+
+  if (!clock)
+    {
+      g_warning ("Unable to create network clock for %s:%d\n", address, port);
+      return NULL;
+    }
+
+  group = clutter_gst_overlay_sync_group_new_with_clock (clock);
+  gst_object_unref (clock);
+
+  return group;
+}
+
+/* Serves the group clock on @address:@port; port 0 picks a free one,
+ * returned by the function. Returns -1 on failure.
+ */
+gint
+clutter_gst_overlay_sync_group_publish_clock (ClutterGstOverlaySyncGroup *self,
+                                              const gchar                *address,
+                                              gint                        port)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self), -1);
+
+  priv = self->priv;
+
+  if (priv->time_provider)
+    gst_object_unref (priv->time_provider);
+
+  priv->time_provider = gst_net_time_provider_new (priv->clock, address, port);
+
+  if (!priv->time_provider)
+    {
+      g_warning ("Unable to publish clock on %s:%d\n",
+                 address ? address : "*", port);
+      return -1;
+    }
+
+  g_object_get (G_OBJECT (priv->time_provider), "port", &port, NULL);
+
+  return port;
+}
+
+/* An actor joining a running group is seeked to the group position
+ * and started on the group base time. A paused group away from 0 is
+ * seeked as a whole, so every actor's segment starts at the same
+ * position and the next play lines them all up.
+ */
+void
+clutter_gst_overlay_sync_group_add_actor (ClutterGstOverlaySyncGroup *self,
+                                          ClutterGstOverlayActor     *actor)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+  GstElement *pipeline;
+  GstClockTime position;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self));
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (actor));
+
+  priv = self->priv;
+
+  if (g_list_find (priv->actors, actor))
+    return;
+
+  priv->actors = g_list_append (priv->actors, g_object_ref (actor));
+  pipeline = get_pipeline (actor);
+
+  attach_pipeline (self, pipeline);
+
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  gst_element_get_state (pipeline, NULL, NULL, PREROLL_TIMEOUT);
+
+  position = clutter_gst_overlay_sync_group_get_position (self);
+
+  if (!priv->playing)
+    {
+      if (position > 0)
+        clutter_gst_overlay_sync_group_seek (self, position);
+
+      return;
+    }
+
+  gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+                           GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+                           position);
+  gst_element_get_state (pipeline, NULL, NULL, PREROLL_TIMEOUT);
+
+  /* After the flush the new segment starts at running time 0, which
+   * must line up with the group having moved on during preroll.
+   */
+  gst_element_set_base_time (pipeline,
+                             gst_clock_get_time (priv->clock) -
+                             (clutter_gst_overlay_sync_group_get_position (self) -
+                              position));
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+}
+
+void
+clutter_gst_overlay_sync_group_remove_actor (ClutterGstOverlaySyncGroup *self,
+                                             ClutterGstOverlayActor     *actor)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+  GList *link;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self));
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (actor));
+
+  priv = self->priv;
+  link = g_list_find (priv->actors, actor);
+
+  if (!link)
+    return;
+
+  priv->actors = g_list_delete_link (priv->actors, link);
+
+  detach_pipeline (get_pipeline (actor));
+
+  g_object_unref (actor);
+}
+
+/* Prerolls every member, then starts them all on one base time
+ * slightly in the future.
+ */
+void
+clutter_gst_overlay_sync_group_play (ClutterGstOverlaySyncGroup *self)
+{
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self));
+
+  if (self->priv->playing)
+    return;
+
+  set_state_all (self, GST_STATE_PAUSED);
+  wait_for_preroll (self);
+
+  start_all (self);
+
+  self->priv->playing = TRUE;
+}
+
+/* Starts from the beginning of the current segment on a base time
+ * chosen elsewhere, usually the publishing process' get_base_time().
+ */
+void
+clutter_gst_overlay_sync_group_play_at (ClutterGstOverlaySyncGroup *self,
+                                        GstClockTime                base_time)
+{
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (base_time));
+
+  set_state_all (self, GST_STATE_PAUSED);
+  wait_for_preroll (self);
+
+  self->priv->running_time = 0;
+
+  start_all_at (self, base_time);
+
+  self->priv->playing = TRUE;
+}
+
+GstClockTime
+clutter_gst_overlay_sync_group_get_base_time (ClutterGstOverlaySyncGroup *self)
+{
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self),
+                        GST_CLOCK_TIME_NONE);
+
+  return self->priv->base_time;
+}
+
+void
+clutter_gst_overlay_sync_group_pause (ClutterGstOverlaySyncGroup *self)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+  GstClockTime now;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self));
+
+  priv = self->priv;
+
+  if (!priv->playing)
+    return;
+
+  /* Paused before the delayed start was reached */
+  now = gst_clock_get_time (priv->clock);
+  priv->running_time = now > priv->base_time ? now - priv->base_time : 0;
+  priv->playing = FALSE;
+
+  set_state_all (self, GST_STATE_PAUSED);
+}
+
+gboolean
+clutter_gst_overlay_sync_group_seek (ClutterGstOverlaySyncGroup *self,
+                                     GstClockTime                position)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+  gboolean playing, result = TRUE;
+  GList *l;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self), FALSE);
+
+  priv = self->priv;
+  playing = priv->playing;
+
+  clutter_gst_overlay_sync_group_pause (self);
+
+  for (l = priv->actors; l; l = l->next)
+    result &= gst_element_seek_simple (get_pipeline (l->data), GST_FORMAT_TIME,
+                                       GST_SEEK_FLAG_FLUSH |
+                                       GST_SEEK_FLAG_ACCURATE,
+                                       position);
+
+  wait_for_preroll (self);
+
+  priv->segment_start = position;
+  priv->running_time = 0;
+
+  if (playing)
+    {
+      start_all (self);
+      priv->playing = TRUE;
+    }
+
+  return result;
+}
+
+/* Stream position the whole group should be showing */
+GstClockTime
+clutter_gst_overlay_sync_group_get_position (ClutterGstOverlaySyncGroup *self)
+{
+  ClutterGstOverlaySyncGroupPrivate *priv;
+  GstClockTime now;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self),
+                        GST_CLOCK_TIME_NONE);
+
+  priv = self->priv;
+
+  if (!priv->playing)
+    return priv->segment_start + priv->running_time;
+
+  now = gst_clock_get_time (priv->clock);
+
+  if (now < priv->base_time)
+    return priv->segment_start;
+
+  return priv->segment_start + (now - priv->base_time);
+}
+
+/* Position of @actor minus the group position; positive means ahead */
+gboolean
+clutter_gst_overlay_sync_group_get_drift (ClutterGstOverlaySyncGroup *self,
+                                          ClutterGstOverlayActor     *actor,
+                                          GstClockTimeDiff           *drift)
+{
+  GstFormat format = GST_FORMAT_TIME;
+  gint64 position;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self), FALSE);
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_ACTOR (actor), FALSE);
+  g_return_val_if_fail (drift != NULL, FALSE);
+
+  if (!g_list_find (self->priv->actors, actor))
+    return FALSE;
+
+  if (!gst_element_query_position (get_pipeline (actor), &format, &position) ||
+      format != GST_FORMAT_TIME)
+    return FALSE;
+
+  *drift = GST_CLOCK_DIFF (clutter_gst_overlay_sync_group_get_position (self),
+                           position);
+
+  return TRUE;
+}
+
+GstClock *
+clutter_gst_overlay_sync_group_get_clock (ClutterGstOverlaySyncGroup *self)
+{
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self), NULL);
+
+  return self->priv->clock;
+}
+
+/* Offset of the group clock against its internal time source,
+ * i.e. the correction a network slave currently applies.
+ */
+gboolean
+clutter_gst_overlay_sync_group_get_clock_offset (ClutterGstOverlaySyncGroup *self,
+                                                 GstClockTimeDiff           *offset)
+{
+  GstClockTime internal, external;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_SYNC_GROUP (self), FALSE);
+  g_return_val_if_fail (offset != NULL, FALSE);
+
+  gst_clock_get_calibration (self->priv->clock, &internal, &external,
+                             NULL, NULL);
+
+  *offset = GST_CLOCK_DIFF (internal, external);
+
+  return TRUE;
+}
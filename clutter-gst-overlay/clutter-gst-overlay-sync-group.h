@@ -0,0 +1,92 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_SYNC_GROUP_H__
+#define __CLUTTER_GST_OVERLAY_SYNC_GROUP_H__
+
+/* clutter-gst-overlay-sync-group.h */
+
+#include <glib-object.h>
+#include <gst/gst.h>
+#include "clutter-gst-overlay-actor.h"
+
+G_BEGIN_DECLS
+
+#define CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP (clutter_gst_overlay_sync_group_get_type ())
+
+#define CLUTTER_GST_OVERLAY_SYNC_GROUP(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP, ClutterGstOverlaySyncGroup))
+
+#define CLUTTER_GST_OVERLAY_SYNC_GROUP_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST ((klass), \
+	CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP, ClutterGstOverlaySyncGroupClass))
+
+#define CLUTTER_IS_GST_OVERLAY_SYNC_GROUP(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP))
+
+#define CLUTTER_IS_GST_OVERLAY_SYNC_GROUP_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), \
+	CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP))
+
+#define CLUTTER_GST_OVERLAY_SYNC_GROUP_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_SYNC_GROUP, ClutterGstOverlaySyncGroupClass))
+
+typedef struct _ClutterGstOverlaySyncGroup         ClutterGstOverlaySyncGroup;
+typedef struct _ClutterGstOverlaySyncGroupClass    ClutterGstOverlaySyncGroupClass;
+typedef struct _ClutterGstOverlaySyncGroupPrivate  ClutterGstOverlaySyncGroupPrivate;
+
+struct _ClutterGstOverlaySyncGroup
+{
+  GObject                             parent;
+  ClutterGstOverlaySyncGroupPrivate  *priv;
+};
+
+struct _ClutterGstOverlaySyncGroupClass
+{
+  GObjectClass parent_class;
+};
+
+GType                          clutter_gst_overlay_sync_group_get_type          (void) G_GNUC_CONST;
+ClutterGstOverlaySyncGroup *   clutter_gst_overlay_sync_group_new               (void);
+ClutterGstOverlaySyncGroup *   clutter_gst_overlay_sync_group_new_with_clock    (GstClock *clock);
+ClutterGstOverlaySyncGroup *   clutter_gst_overlay_sync_group_new_net_slave     (const gchar *address, gint port);
+gint                           clutter_gst_overlay_sync_group_publish_clock     (ClutterGstOverlaySyncGroup *self, const gchar *address, gint port);
+void                           clutter_gst_overlay_sync_group_add_actor         (ClutterGstOverlaySyncGroup *self, ClutterGstOverlayActor *actor);
+void                           clutter_gst_overlay_sync_group_remove_actor      (ClutterGstOverlaySyncGroup *self, ClutterGstOverlayActor *actor);
+void                           clutter_gst_overlay_sync_group_play              (ClutterGstOverlaySyncGroup *self);
+void                           clutter_gst_overlay_sync_group_play_at           (ClutterGstOverlaySyncGroup *self, GstClockTime base_time);
+GstClockTime                   clutter_gst_overlay_sync_group_get_base_time     (ClutterGstOverlaySyncGroup *self);
+void                           clutter_gst_overlay_sync_group_pause             (ClutterGstOverlaySyncGroup *self);
+gboolean                       clutter_gst_overlay_sync_group_seek              (ClutterGstOverlaySyncGroup *self, GstClockTime position);
+GstClockTime                   clutter_gst_overlay_sync_group_get_position      (ClutterGstOverlaySyncGroup *self);
+gboolean                       clutter_gst_overlay_sync_group_get_drift         (ClutterGstOverlaySyncGroup *self, ClutterGstOverlayActor *actor, GstClockTimeDiff *drift);
+GstClock *                     clutter_gst_overlay_sync_group_get_clock         (ClutterGstOverlaySyncGroup *self);
+gboolean                       clutter_gst_overlay_sync_group_get_clock_offset  (ClutterGstOverlaySyncGroup *self, GstClockTimeDiff *offset);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_SYNC_GROUP_H__ */
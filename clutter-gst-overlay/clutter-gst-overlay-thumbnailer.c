@@ -0,0 +1,808 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-thumbnailer.c - Keyframe strips for scrub previews,
+ *                                     cached on disk.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-thumbnailer.h"
+#include "clutter-gst-overlay-private.h"
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include <string.h>
+
+#define CLUTTER_GST_OVERLAY_THUMBNAILER_GET_PRIVATE(obj) \
+        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+        CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER, ClutterGstOverlayThumbnailerPrivate))
+
+#define STRIP_MAGIC           0x54474743 /* "CGGT" */
+#define STRIP_VERSION         1
+#define STRIP_BPP             3
+#define PREROLL_TIMEOUT       (10 * GST_SECOND)
+#define MAX_WORKER_THREADS    2
+#define MAX_CACHED_STRIPS     32
+
+/* On-disk layout: StripHeader, n_frames guint64 positions,
+ * then n_frames RGB images of rowstride * height bytes each.
+ * Everything is naturally aligned so the file can be used in place.
+ */
+typedef struct {
+  guint32 magic;
+  guint32 version;
+  guint32 n_frames;
+  guint32 width;
+  guint32 height;
+  guint32 rowstride;
+  guint64 duration;
+} StripHeader;
+
+struct _ClutterGstOverlayThumbnailStrip
+{
+  volatile gint      ref_count;
+
+  GMappedFile       *file;
+  const StripHeader *header;
+  const guint64     *positions;
+  const guint8      *frames;
+};
+
+struct _ClutterGstOverlayThumbnailerPrivate
+{
+  gchar       *cache_dir;
+
+  GMutex      *lock;
+  GHashTable  *strips;
+  GQueue      *recent;
+
+  GThreadPool *pool;
+};
+
+typedef struct {
+  ClutterGstOverlayThumbnailer         *self;
+  gchar                                *uri;
+  guint                                 n_frames;
+  gint                                  width;
+  gint                                  height;
+
+  ClutterGstOverlayThumbnailerCallback  callback;
+  gpointer                              user_data;
+
+  ClutterGstOverlayThumbnailStrip      *strip;
+  GError                               *error;
+} StripRequest;
+
+enum {
+  PROP_0,
+
+  PROP_CACHE_DIR
+};
+
+G_DEFINE_TYPE (ClutterGstOverlayThumbnailer,
+               clutter_gst_overlay_thumbnailer,
+               G_TYPE_OBJECT);
+
+static gsize
+strip_frame_size (guint32 rowstride,
+                  guint32 height)
+{
+  return (gsize)rowstride * height;
+}
+
+static gsize
+strip_file_size (guint32 n_frames,
+                 guint32 rowstride,
+                 guint32 height)
+{
+  return sizeof (StripHeader) +
+         n_frames * sizeof (guint64) +
+         n_frames * strip_frame_size (rowstride, height);
+}
+
+static ClutterGstOverlayThumbnailStrip *
+strip_new_from_file (const gchar *path,
+                     guint        n_frames,
+                     gint         width,
+                     gint         height,
+                     GError     **error)
+{
+  ClutterGstOverlayThumbnailStrip *strip;
+  const StripHeader *header;
+  GMappedFile *file;
+  const gchar *contents;
+  gsize length;
+
+  file = g_mapped_file_new (path, FALSE, error);
+
+  if (!file)
+    return NULL;
+
+  contents = g_mapped_file_get_contents (file);
+  length = g_mapped_file_get_length (file);
+  header = (const StripHeader *)contents;
+
+  if (length < sizeof (StripHeader) ||
+      header->magic != STRIP_MAGIC ||
+      header->version != STRIP_VERSION ||
+      header->n_frames != n_frames ||
+      header->width != (guint32)width ||
+      header->height != (guint32)height ||
+      length < strip_file_size (header->n_frames, header->rowstride,
+                                header->height))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Thumbnail cache file %s is corrupted", path);
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  strip = g_slice_new0 (ClutterGstOverlayThumbnailStrip);
+  strip->ref_count = 1;
+  strip->file = file;
+  strip->header = header;
+  strip->positions = (const guint64 *)(contents + sizeof (StripHeader));
+  strip->frames = (const guint8 *)(strip->positions + header->n_frames);
+
+  return strip;
+}
+
+static gchar *
+get_strip_key (const gchar *uri,
+               guint        n_frames,
+               gint         width,
+               gint         height)
+{
+  gchar *key, *checksum;
+
+  key = g_strdup_printf ("%s|%u|%dx%d", uri, n_frames, width, height);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  g_free (key);
+
+  return checksum;
+}
+
+static gchar *
+get_strip_path (ClutterGstOverlayThumbnailer *self,
+                const gchar                  *key)
+{
+  gchar *name, *path;
+
+  name = g_strconcat (key, ".strip", NULL);
+  path = g_build_filename (self->priv->cache_dir, name, NULL);
+  g_free (name);
+
+  return path;
+}
+
+static GstElement *
+make_thumbnail_pipeline (const gchar *uri,
+                         gint         width,
+                         gint         height,
+                         GstElement **sink)
+{
+  GstElement *pipeline, *bin, *scale, *convert, *filter, *appsink;
+  GstCaps *caps;
+  GstPad *pad;
+
+  pipeline = gst_element_factory_make ("playbin2", NULL);
+  bin      = gst_bin_new ("thumbnail-sink");
+  scale    = gst_element_factory_make ("videoscale", NULL);
+  convert  = gst_element_factory_make ("ffmpegcolorspace", NULL);
+  filter   = gst_element_factory_make ("capsfilter", NULL);
+  appsink  = gst_element_factory_make ("appsink", NULL);
+
+  if (!pipeline || !scale || !convert || !filter || !appsink)
+    {
+      g_warning ("Unable to create thumbnail pipeline\n");
+
+      if (pipeline)
+        gst_object_unref (pipeline);
+      if (scale)
+        gst_object_unref (scale);
+      if (convert)
+        gst_object_unref (convert);
+      if (filter)
+        gst_object_unref (filter);
+      if (appsink)
+        gst_object_unref (appsink);
+      gst_object_unref (bin);
+
+      return NULL;
+    }
+
+  /* Scaling happens before the colorspace conversion, so the converter
+   * only ever touches thumbnail sized frames.
+   */
+  caps = gst_caps_from_string (GST_VIDEO_CAPS_RGB);
+  gst_caps_set_simple (caps,
+                       "width", G_TYPE_INT, width,
+                       "height", G_TYPE_INT, height,
+                       "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                       NULL);
+  g_object_set (G_OBJECT (filter), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  g_object_set (G_OBJECT (appsink),
+                "sync", FALSE,
+                "max-buffers", 1,
+                NULL);
+
+  gst_bin_add_many (GST_BIN (bin), scale, convert, filter, appsink, NULL);
+  gst_element_link_many (scale, convert, filter, appsink, NULL);
+
+  pad = gst_element_get_static_pad (scale, "sink");
+  gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+  gst_object_unref (pad);
+
+  /* No audio or subtitles, and no playsink conversion of its own */
+  g_object_set (G_OBJECT (pipeline),
+                "uri", uri,
+                "flags", GST_PLAY_FLAG_VIDEO | GST_PLAY_FLAG_NATIVE_VIDEO,
+                "video-sink", bin,
+                "audio-sink", gst_element_factory_make ("fakesink", NULL),
+                NULL);
+
+  *sink = appsink;
+
+  return pipeline;
+}
+
+/* Call with lock held. Keeps the mapped strips to the most recently
+ * used MAX_CACHED_STRIPS; evicted ones stay valid for their holders.
+ */
+static void
+cache_strip_locked (ClutterGstOverlayThumbnailerPrivate *priv,
+                    const gchar                         *key,
+                    ClutterGstOverlayThumbnailStrip     *strip)
+{
+  GList *link = g_queue_find_custom (priv->recent, key, (GCompareFunc) strcmp);
+
+  if (link)
+    g_queue_unlink (priv->recent, link);
+  else
+    link = g_list_alloc ();
+
+  if (!link->data)
+    link->data = g_strdup (key);
+
+  g_queue_push_head_link (priv->recent, link);
+
+  if (strip)
+    g_hash_table_replace (priv->strips, g_strdup (key), strip);
+
+  while (g_queue_get_length (priv->recent) > MAX_CACHED_STRIPS)
+    {
+      gchar *oldest = g_queue_pop_tail (priv->recent);
+
+      g_hash_table_remove (priv->strips, oldest);
+      g_free (oldest);
+    }
+}
+
+static gboolean
+wait_for_preroll (GstElement *pipeline,
+                  GError    **error)
+{
+  GstStateChangeReturn result;
+  GstMessage *msg;
+  GstBus *bus;
+
+  result = gst_element_get_state (pipeline, NULL, NULL, PREROLL_TIMEOUT);
+
+  if (result == GST_STATE_CHANGE_SUCCESS)
+    return TRUE;
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (msg)
+    {
+      GError *gst_error = NULL;
+
+      gst_message_parse_error (msg, &gst_error, NULL);
+      g_propagate_error (error, gst_error);
+      gst_message_unref (msg);
+    }
+  else
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE,
+                 "Thumbnail pipeline failed to preroll");
+
+  return FALSE;
+}
+
+static gboolean
+generate_strip (const gchar *uri,
+                guint        n_frames,
+                gint         width,
+                gint         height,
+                const gchar *path,
+                GError     **error)
+{
+  GstElement *pipeline, *appsink = NULL;
+  GstFormat format = GST_FORMAT_TIME;
+  gint64 duration = -1;
+  StripHeader *header;
+  guint64 *positions;
+  guint8 *data, *frames;
+  gsize frame_size, size;
+  gboolean result = FALSE;
+  guint i;
+
+  pipeline = make_thumbnail_pipeline (uri, width, height, &appsink);
+
+  if (!pipeline)
+    {
+      g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN,
+                   "Unable to create thumbnail pipeline");
+      return FALSE;
+    }
+
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+
+  if (!wait_for_preroll (pipeline, error))
+    goto done;
+
+  if (!gst_element_query_duration (pipeline, &format, &duration) ||
+      format != GST_FORMAT_TIME || duration <= 0)
+    {
+      g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+                   "Unable to get duration of %s", uri);
+      goto done;
+    }
+
+  frame_size = strip_frame_size (GST_ROUND_UP_4 (width * STRIP_BPP), height);
+  size = strip_file_size (n_frames, GST_ROUND_UP_4 (width * STRIP_BPP), height);
+  data = g_malloc0 (size);
+
+  header = (StripHeader *)data;
+  header->magic = STRIP_MAGIC;
+  header->version = STRIP_VERSION;
+  header->n_frames = n_frames;
+  header->width = width;
+  header->height = height;
+  header->rowstride = GST_ROUND_UP_4 (width * STRIP_BPP);
+  header->duration = duration;
+
+  positions = (guint64 *)(data + sizeof (StripHeader));
+  frames = (guint8 *)(positions + n_frames);
+
+  for (i = 0; i < n_frames; i++)
+    {
+      /* Centre of each of the n equal slices of the stream */
+      gint64 position = gst_util_uint64_scale (duration, 2 * i + 1,
+                                               2 * n_frames);
+      GstBuffer *buffer;
+
+      if (!gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+                                    GST_SEEK_FLAG_FLUSH |
+                                    GST_SEEK_FLAG_KEY_UNIT,
+                                    position) ||
+          !wait_for_preroll (pipeline, error))
+        break;
+
+      buffer = gst_app_sink_pull_preroll (GST_APP_SINK (appsink));
+
+      if (!buffer)
+        break;
+
+      positions[i] = GST_BUFFER_TIMESTAMP_IS_VALID (buffer) ?
+                     GST_BUFFER_TIMESTAMP (buffer) : (guint64)position;
+      memcpy (frames + i * frame_size, GST_BUFFER_DATA (buffer),
+              MIN (frame_size, GST_BUFFER_SIZE (buffer)));
+
+      gst_buffer_unref (buffer);
+    }
+
+  if (i == n_frames)
+    result = g_file_set_contents (path, (const gchar *)data, size, error);
+  else if (error && !*error)
+    g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+                 "Unable to decode thumbnail %u of %s", i, uri);
+
+  g_free (data);
+
+done:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return result;
+}
+
+static void
+clutter_gst_overlay_thumbnailer_set_property (GObject      *object,
+                                              guint         property_id,
+                                              const GValue *value,
+                                              GParamSpec   *pspec)
+{
+  ClutterGstOverlayThumbnailer *self = CLUTTER_GST_OVERLAY_THUMBNAILER (object);
+
+  switch (property_id)
+    {
+    case PROP_CACHE_DIR:
+      g_free (self->priv->cache_dir);
+      self->priv->cache_dir = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+clutter_gst_overlay_thumbnailer_get_property (GObject    *object,
+                                              guint       property_id,
+                                              GValue     *value,
+                                              GParamSpec *pspec)
+{
+  ClutterGstOverlayThumbnailer *self = CLUTTER_GST_OVERLAY_THUMBNAILER (object);
+
+  switch (property_id)
+    {
+    case PROP_CACHE_DIR:
+      g_value_set_string (value, self->priv->cache_dir);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+clutter_gst_overlay_thumbnailer_constructed (GObject *gobject)
+{
+  ClutterGstOverlayThumbnailerPrivate *priv = CLUTTER_GST_OVERLAY_THUMBNAILER (gobject)->priv;
+
+  if (!priv->cache_dir)
+    priv->cache_dir = g_build_filename (g_get_user_cache_dir (),
+                                        "clutter-gst-overlay",
+                                        "thumbnails",
+                                        NULL);
+
+  if (g_mkdir_with_parents (priv->cache_dir, 0700) != 0)
+    g_warning ("Unable to create thumbnail cache directory %s\n",
+               priv->cache_dir);
+}
+
+static void
+clutter_gst_overlay_thumbnailer_dispose (GObject *gobject)
+{
+  ClutterGstOverlayThumbnailerPrivate *priv = CLUTTER_GST_OVERLAY_THUMBNAILER (gobject)->priv;
+
+  if (priv->pool)
+    {
+      /* Pending requests hold a reference, so the pool is idle here */
+      g_thread_pool_free (priv->pool, TRUE, TRUE);
+
+      priv->pool = NULL;
+    }
+
+  G_OBJECT_CLASS (clutter_gst_overlay_thumbnailer_parent_class)->dispose (gobject);
+}
+
+static void
+clutter_gst_overlay_thumbnailer_finalize (GObject *gobject)
+{
+  ClutterGstOverlayThumbnailerPrivate *priv = CLUTTER_GST_OVERLAY_THUMBNAILER (gobject)->priv;
+
+  g_hash_table_destroy (priv->strips);
+  g_queue_foreach (priv->recent, (GFunc) g_free, NULL);
+  g_queue_free (priv->recent);
+  g_mutex_free (priv->lock);
+  g_free (priv->cache_dir);
+
+  G_OBJECT_CLASS (clutter_gst_overlay_thumbnailer_parent_class)->finalize (gobject);
+}
+
+static gboolean
+strip_request_complete (gpointer data)
+{
+  StripRequest *request = data;
+
+  if (request->callback)
+    request->callback (request->self, request->strip, request->error,
+                       request->user_data);
+
+  if (request->strip)
+    clutter_gst_overlay_thumbnail_strip_unref (request->strip);
+
+  if (request->error)
+    g_error_free (request->error);
+
+  g_object_unref (request->self);
+  g_free (request->uri);
+  g_slice_free (StripRequest, request);
+
+  return FALSE;
+}
+
+static void
+strip_request_run (gpointer data,
+                   gpointer user_data)
+{
+  StripRequest *request = data;
+
+  request->strip = clutter_gst_overlay_thumbnailer_get_strip (request->self,
+                                                              request->uri,
+                                                              request->n_frames,
+                                                              request->width,
+                                                              request->height,
+                                                              &request->error);
+
+  g_idle_add (strip_request_complete, request);
+}
+
+static void
+clutter_gst_overlay_thumbnailer_init (ClutterGstOverlayThumbnailer *self)
+{
+  ClutterGstOverlayThumbnailerPrivate *priv;
+
+  self->priv = priv = CLUTTER_GST_OVERLAY_THUMBNAILER_GET_PRIVATE (self);
+
+  priv->lock = g_mutex_new ();
+  priv->strips = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify) clutter_gst_overlay_thumbnail_strip_unref);
+  priv->recent = g_queue_new ();
+  priv->pool = g_thread_pool_new (strip_request_run, NULL,
+                                  MAX_WORKER_THREADS, FALSE, NULL);
+}
+
+static void
+clutter_gst_overlay_thumbnailer_class_init (ClutterGstOverlayThumbnailerClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (ClutterGstOverlayThumbnailerPrivate));
+
+  gobject_class->constructed = clutter_gst_overlay_thumbnailer_constructed;
+  gobject_class->dispose = clutter_gst_overlay_thumbnailer_dispose;
+  gobject_class->finalize = clutter_gst_overlay_thumbnailer_finalize;
+  gobject_class->set_property = clutter_gst_overlay_thumbnailer_set_property;
+  gobject_class->get_property = clutter_gst_overlay_thumbnailer_get_property;
+
+  pspec = g_param_spec_string ("cache-dir",
+                               "Cache dir",
+                               "Directory holding the thumbnail strips",
+                               NULL,
+                               G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (gobject_class,
+                                   PROP_CACHE_DIR, pspec);
+}
+
+ClutterGstOverlayThumbnailer *
+clutter_gst_overlay_thumbnailer_new (const gchar *cache_dir)
+{
+  return g_object_new (CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER,
+                       "cache-dir", cache_dir, NULL);
+}
+
+/* Only looks at the memory and disk caches, never decodes.
+ * Cheap enough to call on every hover.
+ */
+ClutterGstOverlayThumbnailStrip *
+clutter_gst_overlay_thumbnailer_lookup_strip (ClutterGstOverlayThumbnailer *self,
+                                              const gchar                  *uri,
+                                              guint                         n_frames,
+                                              gint                          width,
+                                              gint                          height)
+{
+  ClutterGstOverlayThumbnailerPrivate *priv;
+  ClutterGstOverlayThumbnailStrip *strip;
+  gchar *key, *path;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_THUMBNAILER (self), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  priv = self->priv;
+  key = get_strip_key (uri, n_frames, width, height);
+
+  g_mutex_lock (priv->lock);
+
+  strip = g_hash_table_lookup (priv->strips, key);
+
+  if (!strip)
+    {
+      path = get_strip_path (self, key);
+
+      if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        strip = strip_new_from_file (path, n_frames, width, height, NULL);
+
+      if (strip)
+        cache_strip_locked (priv, key, strip);
+
+      g_free (path);
+    }
+  else
+    cache_strip_locked (priv, key, NULL);
+
+  if (strip)
+    clutter_gst_overlay_thumbnail_strip_ref (strip);
+
+  g_mutex_unlock (priv->lock);
+
+  g_free (key);
+
+  return strip;
+}
+
+/* Blocks while decoding; use clutter_gst_overlay_thumbnailer_request_strip
+ * from the main loop.
+ */
+ClutterGstOverlayThumbnailStrip *
+clutter_gst_overlay_thumbnailer_get_strip (ClutterGstOverlayThumbnailer *self,
+                                           const gchar                  *uri,
+                                           guint                         n_frames,
+                                           gint                          width,
+                                           gint                          height,
+                                           GError                      **error)
+{
+  ClutterGstOverlayThumbnailStrip *strip;
+  gchar *key, *path;
+
+  g_return_val_if_fail (CLUTTER_IS_GST_OVERLAY_THUMBNAILER (self), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+  g_return_val_if_fail (n_frames > 0 && width > 0 && height > 0, NULL);
+
+  strip = clutter_gst_overlay_thumbnailer_lookup_strip (self, uri, n_frames,
+                                                        width, height);
+
+  if (strip)
+    return strip;
+
+  key = get_strip_key (uri, n_frames, width, height);
+  path = get_strip_path (self, key);
+
+  if (generate_strip (uri, n_frames, width, height, path, error))
+    strip = strip_new_from_file (path, n_frames, width, height, error);
+
+  if (strip)
+    {
+      g_mutex_lock (self->priv->lock);
+      cache_strip_locked (self->priv, key,
+                          clutter_gst_overlay_thumbnail_strip_ref (strip));
+      g_mutex_unlock (self->priv->lock);
+    }
+
+  g_free (path);
+  g_free (key);
+
+  return strip;
+}
+
+void
+clutter_gst_overlay_thumbnailer_request_strip (ClutterGstOverlayThumbnailer        *self,
+                                               const gchar                         *uri,
+                                               guint                                n_frames,
+                                               gint                                 width,
+                                               gint                                 height,
+                                               ClutterGstOverlayThumbnailerCallback callback,
+                                               gpointer                             user_data)
+{
+  StripRequest *request;
+
+  g_return_if_fail (CLUTTER_IS_GST_OVERLAY_THUMBNAILER (self));
+  g_return_if_fail (uri != NULL);
+
+  request = g_slice_new0 (StripRequest);
+  request->self = g_object_ref (self);
+  request->uri = g_strdup (uri);
+  request->n_frames = n_frames;
+  request->width = width;
+  request->height = height;
+  request->callback = callback;
+  request->user_data = user_data;
+
+  request->strip = clutter_gst_overlay_thumbnailer_lookup_strip (self, uri,
+                                                                 n_frames,
+                                                                 width, height);
+
+  if (request->strip)
+    g_idle_add (strip_request_complete, request);
+  else
+    g_thread_pool_push (self->priv->pool, request, NULL);
+}
+
+ClutterGstOverlayThumbnailStrip *
+clutter_gst_overlay_thumbnail_strip_ref (ClutterGstOverlayThumbnailStrip *strip)
+{
+  g_return_val_if_fail (strip != NULL, NULL);
+
+  g_atomic_int_inc (&strip->ref_count);
+
+  return strip;
+}
+
+void
+clutter_gst_overlay_thumbnail_strip_unref (ClutterGstOverlayThumbnailStrip *strip)
+{
+  g_return_if_fail (strip != NULL);
+
+  if (g_atomic_int_dec_and_test (&strip->ref_count))
+    {
+      g_mapped_file_unref (strip->file);
+      g_slice_free (ClutterGstOverlayThumbnailStrip, strip);
+    }
+}
+
+guint
+clutter_gst_overlay_thumbnail_strip_get_n_frames (ClutterGstOverlayThumbnailStrip *strip)
+{
+  g_return_val_if_fail (strip != NULL, 0);
+
+  return strip->header->n_frames;
+}
+
+void
+clutter_gst_overlay_thumbnail_strip_get_size (ClutterGstOverlayThumbnailStrip *strip,
+                                              gint                            *width,
+                                              gint                            *height,
+                                              gint                            *rowstride)
+{
+  g_return_if_fail (strip != NULL);
+
+  if (width)
+    *width = strip->header->width;
+
+  if (height)
+    *height = strip->header->height;
+
+  if (rowstride)
+    *rowstride = strip->header->rowstride;
+}
+
+/* Returns packed 24-bit RGB owned by the strip */
+const guint8 *
+clutter_gst_overlay_thumbnail_strip_get_frame (ClutterGstOverlayThumbnailStrip *strip,
+                                               guint                            index,
+                                               GstClockTime                    *position)
+{
+  const StripHeader *header;
+
+  g_return_val_if_fail (strip != NULL, NULL);
+  g_return_val_if_fail (index < strip->header->n_frames, NULL);
+
+  header = strip->header;
+
+  if (position)
+    *position = strip->positions[index];
+
+  return strip->frames + index * strip_frame_size (header->rowstride,
+                                                   header->height);
+}
+
+guint
+clutter_gst_overlay_thumbnail_strip_get_index (ClutterGstOverlayThumbnailStrip *strip,
+                                               gdouble                          progress)
+{
+  guint n_frames;
+
+  g_return_val_if_fail (strip != NULL, 0);
+
+  n_frames = strip->header->n_frames;
+
+  return CLAMP ((gint)(progress * n_frames), 0, (gint)n_frames - 1);
+}
@@ -0,0 +1,95 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_THUMBNAILER_H__
+#define __CLUTTER_GST_OVERLAY_THUMBNAILER_H__
+
+/* clutter-gst-overlay-thumbnailer.h */
+
+#include <glib-object.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER (clutter_gst_overlay_thumbnailer_get_type ())
+
+#define CLUTTER_GST_OVERLAY_THUMBNAILER(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER, ClutterGstOverlayThumbnailer))
+
+#define CLUTTER_GST_OVERLAY_THUMBNAILER_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST ((klass), \
+	CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER, ClutterGstOverlayThumbnailerClass))
+
+#define CLUTTER_IS_GST_OVERLAY_THUMBNAILER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER))
+
+#define CLUTTER_IS_GST_OVERLAY_THUMBNAILER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), \
+	CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER))
+
+#define CLUTTER_GST_OVERLAY_THUMBNAILER_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+	CLUTTER_TYPE_GST_OVERLAY_THUMBNAILER, ClutterGstOverlayThumbnailerClass))
+
+typedef struct _ClutterGstOverlayThumbnailer         ClutterGstOverlayThumbnailer;
+typedef struct _ClutterGstOverlayThumbnailerClass    ClutterGstOverlayThumbnailerClass;
+typedef struct _ClutterGstOverlayThumbnailerPrivate  ClutterGstOverlayThumbnailerPrivate;
+
+/* Opaque, reference counted set of RGB frames mapped from the disk cache */
+typedef struct _ClutterGstOverlayThumbnailStrip      ClutterGstOverlayThumbnailStrip;
+
+struct _ClutterGstOverlayThumbnailer
+{
+  GObject                               parent;
+  ClutterGstOverlayThumbnailerPrivate  *priv;
+};
+
+struct _ClutterGstOverlayThumbnailerClass
+{
+  GObjectClass parent_class;
+};
+
+typedef void (* ClutterGstOverlayThumbnailerCallback) (ClutterGstOverlayThumbnailer    *thumbnailer,
+                                                       ClutterGstOverlayThumbnailStrip *strip,
+                                                       const GError                    *error,
+                                                       gpointer                         user_data);
+
+GType                              clutter_gst_overlay_thumbnailer_get_type              (void) G_GNUC_CONST;
+ClutterGstOverlayThumbnailer *     clutter_gst_overlay_thumbnailer_new                   (const gchar *cache_dir);
+ClutterGstOverlayThumbnailStrip *  clutter_gst_overlay_thumbnailer_lookup_strip          (ClutterGstOverlayThumbnailer *self, const gchar *uri, guint n_frames, gint width, gint height);
+ClutterGstOverlayThumbnailStrip *  clutter_gst_overlay_thumbnailer_get_strip             (ClutterGstOverlayThumbnailer *self, const gchar *uri, guint n_frames, gint width, gint height, GError **error);
+void                               clutter_gst_overlay_thumbnailer_request_strip         (ClutterGstOverlayThumbnailer *self, const gchar *uri, guint n_frames, gint width, gint height, ClutterGstOverlayThumbnailerCallback callback, gpointer user_data);
+
+ClutterGstOverlayThumbnailStrip *  clutter_gst_overlay_thumbnail_strip_ref               (ClutterGstOverlayThumbnailStrip *strip);
+void                               clutter_gst_overlay_thumbnail_strip_unref             (ClutterGstOverlayThumbnailStrip *strip);
+guint                              clutter_gst_overlay_thumbnail_strip_get_n_frames      (ClutterGstOverlayThumbnailStrip *strip);
+void                               clutter_gst_overlay_thumbnail_strip_get_size          (ClutterGstOverlayThumbnailStrip *strip, gint *width, gint *height, gint *rowstride);
+const guint8 *                     clutter_gst_overlay_thumbnail_strip_get_frame         (ClutterGstOverlayThumbnailStrip *strip, guint index, GstClockTime *position);
+guint                              clutter_gst_overlay_thumbnail_strip_get_index         (ClutterGstOverlayThumbnailStrip *strip, gdouble progress);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_THUMBNAILER_H__ */
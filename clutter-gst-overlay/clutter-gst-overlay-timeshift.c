@@ -0,0 +1,369 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-timeshift.c - On-disk ring buffer of encoded data
+ *                                   for pausing live streams.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-timeshift.h"
+#include <glib/gstdio.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/* One index entry per this many bytes is enough to seek by time */
+#define INDEX_INTERVAL (64 * 1024)
+
+typedef struct {
+  guint64      offset;
+  GstClockTime time;
+} IndexEntry;
+
+struct _ClutterGstOverlayTimeshift
+{
+  gint          fd;
+  guint8       *map;
+  guint64       size;
+
+  GMutex       *lock;
+
+  /* [tail, write_offset) is readable. reserve_offset runs ahead of
+   * write_offset while the writer is busy, so readers never copy
+   * bytes that are being overwritten.
+   */
+  guint64       write_offset;
+  guint64       reserve_offset;
+  GstClockTime  last_time;
+  GArray       *index;
+};
+
+static guint64
+get_tail (ClutterGstOverlayTimeshift *timeshift)
+{
+  return timeshift->reserve_offset > timeshift->size ?
+         timeshift->reserve_offset - timeshift->size : 0;
+}
+
+static gboolean
+write_all (gint          fd,
+           const guint8 *data,
+           gsize         size,
+           off_t         position)
+{
+  while (size > 0)
+    {
+      gssize written = pwrite (fd, data, size, position);
+
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return FALSE;
+        }
+
+      data += written;
+      size -= written;
+      position += written;
+    }
+
+  return TRUE;
+}
+
+/* Call with lock held. Keeps one entry at or below the tail so
+ * the oldest readable byte still has a time.
+ */
+static void
+prune_index_locked (ClutterGstOverlayTimeshift *timeshift)
+{
+  guint64 tail = get_tail (timeshift);
+  guint n = 0;
+
+  while (n + 1 < timeshift->index->len &&
+         g_array_index (timeshift->index, IndexEntry, n + 1).offset <= tail)
+    n++;
+
+  if (n > 0)
+    g_array_remove_range (timeshift->index, 0, n);
+}
+
+/* Index of the last entry whose key is <= value, or 0 */
+static guint
+find_entry_locked (ClutterGstOverlayTimeshift *timeshift,
+                   gboolean                    by_time,
+                   guint64                     value)
+{
+  guint low = 0, high = timeshift->index->len;
+
+  while (high - low > 1)
+    {
+      guint middle = (low + high) / 2;
+      IndexEntry *entry = &g_array_index (timeshift->index, IndexEntry, middle);
+
+      if ((by_time ? entry->time : entry->offset) <= value)
+        low = middle;
+      else
+        high = middle;
+    }
+
+  return low;
+}
+
+/* @path may be NULL for an anonymous file in the temp directory */
+ClutterGstOverlayTimeshift *
+clutter_gst_overlay_timeshift_new (const gchar *path,
+                                   guint64      size,
+                                   GError     **error)
+{
+  ClutterGstOverlayTimeshift *timeshift;
+  gchar *tmp_path = NULL;
+  gint fd;
+  void *map;
+
+  g_return_val_if_fail (size > 0, NULL);
+
+  if (path)
+    fd = g_open (path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  else
+    fd = g_file_open_tmp ("clutter-gst-overlay-timeshift-XXXXXX",
+                          &tmp_path, error);
+
+  if (fd < 0)
+    {
+      if (path)
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to open timeshift file %s: %s",
+                     path, g_strerror (errno));
+      return NULL;
+    }
+
+  if (tmp_path)
+    {
+      g_unlink (tmp_path);
+      g_free (tmp_path);
+    }
+
+  if (ftruncate (fd, size) != 0 ||
+      (map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "Unable to map timeshift file: %s", g_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+
+  timeshift = g_slice_new0 (ClutterGstOverlayTimeshift);
+  timeshift->fd = fd;
+  timeshift->map = map;
+  timeshift->size = size;
+  timeshift->lock = g_mutex_new ();
+  timeshift->last_time = GST_CLOCK_TIME_NONE;
+  timeshift->index = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+
+  return timeshift;
+}
+
+void
+clutter_gst_overlay_timeshift_free (ClutterGstOverlayTimeshift *timeshift)
+{
+  g_return_if_fail (timeshift != NULL);
+
+  munmap (timeshift->map, timeshift->size);
+  close (timeshift->fd);
+
+  g_array_free (timeshift->index, TRUE);
+  g_mutex_free (timeshift->lock);
+
+  g_slice_free (ClutterGstOverlayTimeshift, timeshift);
+}
+
+/* Appends at the live edge, overwriting the oldest data once full.
+ * Writes are plain sequential pwrite()s, wrapping once at the end.
+ */
+gboolean
+clutter_gst_overlay_timeshift_write (ClutterGstOverlayTimeshift *timeshift,
+                                     const guint8               *data,
+                                     gsize                       size,
+                                     GstClockTime                time)
+{
+  guint64 offset, position;
+  gsize first;
+  gboolean result;
+
+  g_return_val_if_fail (timeshift != NULL, FALSE);
+
+  g_mutex_lock (timeshift->lock);
+
+  offset = timeshift->write_offset;
+
+  /* Only the last size bytes of an oversized write can survive */
+  if (size > timeshift->size)
+    {
+      offset += size - timeshift->size;
+      data += size - timeshift->size;
+      size = timeshift->size;
+    }
+
+  timeshift->reserve_offset = offset + size;
+  prune_index_locked (timeshift);
+
+  if (timeshift->index->len == 0 ||
+      offset - g_array_index (timeshift->index, IndexEntry,
+                              timeshift->index->len - 1).offset >= INDEX_INTERVAL)
+    {
+      IndexEntry entry = { offset, time };
+
+      g_array_append_val (timeshift->index, entry);
+    }
+
+  g_mutex_unlock (timeshift->lock);
+
+  position = offset % timeshift->size;
+  first = MIN (size, timeshift->size - position);
+
+  result = write_all (timeshift->fd, data, first, position) &&
+           write_all (timeshift->fd, data + first, size - first, 0);
+
+  g_mutex_lock (timeshift->lock);
+
+  timeshift->write_offset = offset + size;
+  timeshift->last_time = time;
+
+  g_mutex_unlock (timeshift->lock);
+
+  return result;
+}
+
+/* Copies up to @size bytes at *@offset, moving *@offset past them.
+ * Returns 0 at the live edge and -1, leaving *@offset alone, when it
+ * fell out of the window: those bytes are gone.
+ */
+gssize
+clutter_gst_overlay_timeshift_read (ClutterGstOverlayTimeshift *timeshift,
+                                    guint64                    *offset,
+                                    guint8                     *dest,
+                                    gsize                       size)
+{
+  guint64 position;
+  gsize n = 0, first;
+
+  g_return_val_if_fail (timeshift != NULL, -1);
+  g_return_val_if_fail (offset != NULL, -1);
+
+  g_mutex_lock (timeshift->lock);
+
+  if (*offset < get_tail (timeshift) || *offset > timeshift->write_offset)
+    {
+      g_mutex_unlock (timeshift->lock);
+      return -1;
+    }
+
+  if (*offset < timeshift->write_offset)
+    {
+      n = MIN (size, timeshift->write_offset - *offset);
+      position = *offset % timeshift->size;
+      first = MIN (n, timeshift->size - position);
+
+      memcpy (dest, timeshift->map + position, first);
+      memcpy (dest + first, timeshift->map, n - first);
+
+      *offset += n;
+    }
+
+  g_mutex_unlock (timeshift->lock);
+
+  return n;
+}
+
+void
+clutter_gst_overlay_timeshift_get_window (ClutterGstOverlayTimeshift *timeshift,
+                                          guint64                    *start_offset,
+                                          guint64                    *end_offset,
+                                          GstClockTime               *start_time,
+                                          GstClockTime               *end_time)
+{
+  g_return_if_fail (timeshift != NULL);
+
+  g_mutex_lock (timeshift->lock);
+
+  if (start_offset)
+    *start_offset = get_tail (timeshift);
+
+  if (end_offset)
+    *end_offset = timeshift->write_offset;
+
+  if (start_time)
+    *start_time = timeshift->index->len > 0 ?
+                  g_array_index (timeshift->index, IndexEntry, 0).time :
+                  GST_CLOCK_TIME_NONE;
+
+  if (end_time)
+    *end_time = timeshift->last_time;
+
+  g_mutex_unlock (timeshift->lock);
+}
+
+/* Indexed offset at or before @time, clamped to the window */
+guint64
+clutter_gst_overlay_timeshift_get_offset_at_time (ClutterGstOverlayTimeshift *timeshift,
+                                                  GstClockTime                time)
+{
+  guint64 offset = 0;
+
+  g_return_val_if_fail (timeshift != NULL, 0);
+
+  g_mutex_lock (timeshift->lock);
+
+  if (timeshift->index->len > 0)
+    offset = g_array_index (timeshift->index, IndexEntry,
+                            find_entry_locked (timeshift, TRUE, time)).offset;
+
+  offset = CLAMP (offset, get_tail (timeshift), timeshift->write_offset);
+
+  g_mutex_unlock (timeshift->lock);
+
+  return offset;
+}
+
+GstClockTime
+clutter_gst_overlay_timeshift_get_time_at_offset (ClutterGstOverlayTimeshift *timeshift,
+                                                  guint64                     offset)
+{
+  GstClockTime time = GST_CLOCK_TIME_NONE;
+
+  g_return_val_if_fail (timeshift != NULL, GST_CLOCK_TIME_NONE);
+
+  g_mutex_lock (timeshift->lock);
+
+  if (timeshift->index->len > 0)
+    time = g_array_index (timeshift->index, IndexEntry,
+                          find_entry_locked (timeshift, FALSE, offset)).time;
+
+  g_mutex_unlock (timeshift->lock);
+
+  return time;
+}
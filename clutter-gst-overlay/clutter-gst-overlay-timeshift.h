@@ -0,0 +1,51 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_TIMESHIFT_H__
+#define __CLUTTER_GST_OVERLAY_TIMESHIFT_H__
+
+/* clutter-gst-overlay-timeshift.h */
+
+#include <glib.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Bounded on-disk ring of encoded stream data. One thread writes at
+ * the live edge, another reads anywhere inside the window. Offsets
+ * are logical and only ever grow; the window is the last size bytes.
+ */
+typedef struct _ClutterGstOverlayTimeshift ClutterGstOverlayTimeshift;
+
+ClutterGstOverlayTimeshift *  clutter_gst_overlay_timeshift_new                (const gchar *path, guint64 size, GError **error);
+void                          clutter_gst_overlay_timeshift_free               (ClutterGstOverlayTimeshift *timeshift);
+gboolean                      clutter_gst_overlay_timeshift_write              (ClutterGstOverlayTimeshift *timeshift, const guint8 *data, gsize size, GstClockTime time);
+gssize                        clutter_gst_overlay_timeshift_read               (ClutterGstOverlayTimeshift *timeshift, guint64 *offset, guint8 *dest, gsize size);
+void                          clutter_gst_overlay_timeshift_get_window         (ClutterGstOverlayTimeshift *timeshift, guint64 *start_offset, guint64 *end_offset, GstClockTime *start_time, GstClockTime *end_time);
+guint64                       clutter_gst_overlay_timeshift_get_offset_at_time (ClutterGstOverlayTimeshift *timeshift, GstClockTime time);
+GstClockTime                  clutter_gst_overlay_timeshift_get_time_at_offset (ClutterGstOverlayTimeshift *timeshift, guint64 offset);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_TIMESHIFT_H__ */
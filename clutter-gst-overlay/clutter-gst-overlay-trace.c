@@ -0,0 +1,165 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * clutter-gst-overlay-trace.c - Lock-free ring of latency spans,
+ *                               exported as Chrome trace JSON.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "clutter-gst-overlay-trace.h"
+#include <unistd.h>
+
+/* Power of two, so the ticket wraps into a slot with a mask */
+#define TRACE_RING_SIZE 4096
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+/* seq is 0 while the slot is being written, then its ticket + 1,
+ * so a dump can tell a complete event from a torn or stale one.
+ */
+typedef struct {
+  volatile gint  seq;
+  const gchar   *name;
+  const gchar   *detail;
+  gconstpointer  object;
+  guint          thread;
+  gint64         start;
+  gint64         duration;
+} TraceEvent;
+
+volatile gint _clutter_gst_overlay_trace_enabled = 0;
+
+static TraceEvent trace_ring[TRACE_RING_SIZE];
+static volatile gint trace_next = 0;
+static volatile gint trace_next_thread = 0;
+static GStaticPrivate trace_thread = G_STATIC_PRIVATE_INIT;
+
+/* Small per-thread ids read better in the viewer than pointers */
+static guint
+get_thread_id (void)
+{
+  gpointer id = g_static_private_get (&trace_thread);
+
+  if (!id)
+    {
+      id = GINT_TO_POINTER (g_atomic_int_exchange_and_add (&trace_next_thread, 1) + 1);
+      g_static_private_set (&trace_thread, id, NULL);
+    }
+
+  return GPOINTER_TO_UINT (id);
+}
+
+void
+clutter_gst_overlay_trace_set_enabled (gboolean enabled)
+{
+  g_atomic_int_set (&_clutter_gst_overlay_trace_enabled, enabled ? 1 : 0);
+}
+
+gboolean
+clutter_gst_overlay_trace_get_enabled (void)
+{
+  return g_atomic_int_get (&_clutter_gst_overlay_trace_enabled);
+}
+
+/* Safe from any thread. Writers only share the ticket counter */
+void
+clutter_gst_overlay_trace_record (const gchar   *name,
+                                  const gchar   *detail,
+                                  gconstpointer  object,
+                                  gint64         start)
+{
+  gint64 end = g_get_monotonic_time ();
+  gint ticket = g_atomic_int_exchange_and_add (&trace_next, 1);
+  TraceEvent *event = &trace_ring[ticket & TRACE_RING_MASK];
+
+  g_atomic_int_set (&event->seq, 0);
+
+  event->name = name;
+  event->detail = detail;
+  event->object = object;
+  event->thread = get_thread_id ();
+  event->start = start;
+  event->duration = end - start;
+
+  g_atomic_int_set (&event->seq, ticket + 1);
+}
+
+void
+clutter_gst_overlay_trace_clear (void)
+{
+  gint i;
+
+  for (i = 0; i < TRACE_RING_SIZE; i++)
+    g_atomic_int_set (&trace_ring[i].seq, 0);
+}
+
+/* Writes the events still in the ring, oldest first. Events written
+ * while dumping may be missing.
+ */
+gboolean
+clutter_gst_overlay_trace_dump (const gchar *path,
+                                GError     **error)
+{
+  gint next = g_atomic_int_get (&trace_next);
+  gint first = MAX (next - TRACE_RING_SIZE, 0);
+  gboolean separator = FALSE, result;
+  GString *json;
+  gint ticket;
+
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  json = g_string_new ("{\"traceEvents\":[");
+
+  for (ticket = first; ticket < next; ticket++)
+    {
+      TraceEvent *slot = &trace_ring[ticket & TRACE_RING_MASK];
+      TraceEvent event = *slot;
+
+      if (event.seq != ticket + 1 ||
+          g_atomic_int_get (&slot->seq) != ticket + 1)
+        continue;
+
+      g_string_append_printf (json,
+                              "%s\n{\"name\":\"%s%s%s\",\"ph\":\"X\","
+                              "\"ts\":%" G_GINT64_FORMAT ","
+                              "\"dur\":%" G_GINT64_FORMAT ","
+                              "\"pid\":%d,\"tid\":%u,"
+                              "\"args\":{\"object\":\"%p\"}}",
+                              separator ? "," : "",
+                              event.name,
+                              event.detail ? " " : "",
+                              event.detail ? event.detail : "",
+                              event.start, event.duration,
+                              (gint) getpid (), event.thread,
+                              event.object);
+      separator = TRUE;
+    }
+
+  g_string_append (json, "\n]}\n");
+
+  result = g_file_set_contents (path, json->str, json->len, error);
+
+  g_string_free (json, TRUE);
+
+  return result;
+}
@@ -0,0 +1,61 @@
+/*
+ * clutter-gst-overlay.
+ *
+ * Clutter actor controlling GStreamer window.
+ *
+ * Authored By Viatcheslav Gachkaylo  <vgachkaylo@crystalnix.com>
+ *             Vadim Zakondyrin       <thekondr@crystalnix.com>
+ *
+ * Copyright (C) 2011 Crystalnix
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUTTER_GST_OVERLAY_TRACE_H__
+#define __CLUTTER_GST_OVERLAY_TRACE_H__
+
+/* clutter-gst-overlay-trace.h */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Process-wide span tracing into a fixed ring of the latest events,
+ * dumped as Chrome trace JSON (chrome://tracing). While disabled a
+ * span costs one load of a global and a branch.
+ *
+ * A span starts with CLUTTER_GST_OVERLAY_TRACE_BEGIN (), which is 0
+ * while disabled, and is recorded by CLUTTER_GST_OVERLAY_TRACE_END ().
+ * Name and detail must be static strings.
+ */
+extern volatile gint _clutter_gst_overlay_trace_enabled;
+
+#define CLUTTER_GST_OVERLAY_TRACE_BEGIN() \
+  (G_UNLIKELY (_clutter_gst_overlay_trace_enabled) ? g_get_monotonic_time () : 0)
+
+#define CLUTTER_GST_OVERLAY_TRACE_END(name, detail, object, start) G_STMT_START { \
+  gint64 _trace_start = (start);                                                  \
+  if (G_UNLIKELY (_trace_start))                                                  \
+    clutter_gst_overlay_trace_record ((name), (detail), (object), _trace_start);  \
+} G_STMT_END
+
+void          clutter_gst_overlay_trace_set_enabled   (gboolean enabled);
+gboolean      clutter_gst_overlay_trace_get_enabled   (void);
+void          clutter_gst_overlay_trace_clear         (void);
+gboolean      clutter_gst_overlay_trace_dump          (const gchar *path, GError **error);
+void          clutter_gst_overlay_trace_record        (const gchar *name, const gchar *detail, gconstpointer object, gint64 start);
+
+G_END_DECLS
+
+#endif /* __CLUTTER_GST_OVERLAY_TRACE_H__ */
@@ -1,6 +1,6 @@
 /* 
 
-gcc -o sample/sample sample/sample.c clutter-gst-overlay/clutter-gst-overlay-actor.c `pkg-config --libs --cflags clutter-1.0 gstreamer-0.10 gstreamer-interfaces-0.10 gstreamer-video-0.10`
+gcc -o sample/sample sample/sample.c clutter-gst-overlay/clutter-gst-overlay-actor.c clutter-gst-overlay/clutter-gst-overlay-thumbnailer.c clutter-gst-overlay/clutter-gst-overlay-sync-group.c clutter-gst-overlay/clutter-gst-overlay-timeshift.c clutter-gst-overlay/clutter-gst-overlay-subtitles.c clutter-gst-overlay/clutter-gst-overlay-audio-mixer.c clutter-gst-overlay/clutter-gst-overlay-prober.c clutter-gst-overlay/clutter-gst-overlay-trace.c `pkg-config --libs --cflags clutter-1.0 gstreamer-0.10 gstreamer-interfaces-0.10 gstreamer-video-0.10 gstreamer-app-0.10 gstreamer-base-0.10 gstreamer-net-0.10 gstreamer-pbutils-0.10 xext`
 
  */
 
@@ -114,20 +114,31 @@ gboolean test_video_size (gpointer user_data)
 gboolean test_streams (gpointer user_data)
 {
   ClutterGstOverlayActor *actor = CLUTTER_GST_OVERLAY_ACTOR (user_data);
-  gint ct, nt, ca, na, cv, nv;
+  ClutterGstOverlayMediaInfo info;
+  gchar *title = NULL;
 
-  g_object_get (G_OBJECT (actor),
-                "current-text", &ct,
-                "n-text", &nt,
-                "current-audio", &ca,
-                "n-audio", &na,
-                "current-video", &cv,
-                "n-video", &nv, NULL);
+  clutter_gst_overlay_actor_get_media_info (actor, &info);
 
-  g_print ("Subtitle stream: %d / %d\n"
+  if (info.tags)
+    gst_tag_list_get_string (info.tags, GST_TAG_TITLE, &title);
+
+  g_print ("Title:           %s\n"
+           "Subtitle stream: %d / %d\n"
            "Audio stream:    %d / %d\n"
-           "Video stream:    %d / %d\n",
-           ct, nt, ca, na, cv, nv);
+           "Video stream:    %d / %d\n"
+           "Video size:      %dx%d\n"
+           "Position:        %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "\n"
+           "Seekable:        %s\n",
+           title ? title : "(none)",
+           info.current_text, info.n_text,
+           info.current_audio, info.n_audio,
+           info.current_video, info.n_video,
+           info.width, info.height,
+           GST_TIME_ARGS (info.position), GST_TIME_ARGS (info.duration),
+           info.can_seek ? "yes" : "no");
+
+  g_free (title);
+  clutter_gst_overlay_media_info_clear (&info);
 
   return FALSE;
 }